@@ -47,13 +47,54 @@ typedef struct BitmapHeader {
 } BitmapHeader;
 #pragma pack(pop)
 
+// NOTE: Renderer side texel formats, picked when the bitmap is loaded so drawing never converts texels.
+// Straight:      u32 ARGB, sRGB, not premultiplied (what stb/bmp files give us)
+// Premultiplied: u32 ARGB, sRGB, premultiplied. For draw_bitmap.
+// Linear16:      u16 b, g, r, a (low to high), linear (squared sRGB), premultiplied. For draw_bitmap_basis.
+//                Has a transparent 1 texel apron on every side for bilinear filtering: base points at
+//                the first texel inside the apron and stride includes it, so base[-1] and base[width]
+//                are valid.
+//                Also gets a mip chain (see bitmap_build_mips()) for scaled draws.
+// Linear16Block: Linear16 texels (apron and mips included) stored in 4x4 blocks instead of rows, so a
+//                rotated draw touches about the same cache lines at any angle. Each block stores a 5x5
+//                footprint, the extra column/row repeats the first texels of the next block, so the 2x2
+//                a bilinear sample reads never crosses a block. Block coordinates start at the apron:
+//                texel (x, y) lives at apron coordinate (x + 1, y + 1). base points at the first block,
+//                stride is the bytes per row of blocks.
+typedef enum BitmapFormat{
+    BitmapFormat_Straight,
+    BitmapFormat_Premultiplied,
+    BitmapFormat_Linear16,
+    BitmapFormat_Linear16Block,
+} BitmapFormat;
+
+#define TEXEL_BLOCK_DIM 4
+#define TEXEL_BLOCK_PITCH (TEXEL_BLOCK_DIM + 1)
+#define TEXEL_BLOCK_BYTES (TEXEL_BLOCK_PITCH * TEXEL_BLOCK_PITCH * (s32)sizeof(u64))
+
 typedef struct Bitmap{
     u8*  base;
 	s32  width;
 	s32  height;
 	s32  stride;
+    BitmapFormat format;
+    // NOTE: mips[0] is this bitmap, mips[i] is half of mips[i - 1] rounded down (min 1), each
+    // with its own apron. mip_count is 0 when there is no chain.
+    u32 mip_count;
+    struct Bitmap* mips;
+    // NOTE: changes whenever the texels are (re)written. Draw commands carry the Bitmap by value,
+    // so this lands in the tile damage hash and a reload at the same address still dirties tiles.
+    u32 generation;
 } Bitmap;
 
+global u32 bitmap_generation_next = 1;
+
+static u32
+bitmap_new_generation(){
+    u32 result = bitmap_generation_next++;
+    return(result);
+}
+
 //#define STBI_MALLOC, STBI_REALLOC, and STBI_FREE to avoid using malloc,realloc,free
 //#ifndef STBI_MALLOC
 //#define STBI_MALLOC(sz)           malloc(sz)
@@ -72,6 +113,7 @@ stb_load_image(String8 dir, String8 file){
     result.base = (u8*)stbi_load((char const*)full_path.str, &result.width, &result.width, &result.stride, 0);
 //    unsigned char *data = stbi_load(filename, &x, &y, &n, 0);
     result.stride = result.width * result.stride;
+    result.generation = bitmap_new_generation();
 
     end_scratch(scratch);
     return(result);
@@ -96,9 +138,173 @@ find_first_set_bit(u32 value){
     return(result);
 }
 
+// NOTE: Straight -> Premultiplied, in place. c * a / 255 rounded, same math as the renderer's blend.
+static void
+bitmap_premultiply(Bitmap* bitmap){
+    assert(bitmap->format == BitmapFormat_Straight);
+    for(s32 y=0; y < bitmap->height; ++y){
+        u32* texel = (u32*)(bitmap->base + (y * bitmap->stride));
+        for(s32 x=0; x < bitmap->width; ++x){
+            u32 color = texel[x];
+            u32 a = color >> 24;
+            u32 result = a << 24;
+            for(u32 shift=0; shift < 24; shift += 8){
+                u32 channel = ((color >> shift) & 0xFF) * a + 0x80;
+                result |= (((channel * 257) >> 16) << shift);
+            }
+            texel[x] = result;
+        }
+    }
+    bitmap->format = BitmapFormat_Premultiplied;
+    bitmap->generation = bitmap_new_generation();
+}
+
+// NOTE: Straight -> Linear16 with apron, into a new allocation from arena
+static Bitmap
+bitmap_to_linear16(Arena* arena, Bitmap* bitmap){
+    assert(bitmap->format == BitmapFormat_Straight);
+
+    // NOTE: squared sRGB, premultiplied, in 16 bits. One table lookup per channel instead of float math
+    u16 linear_table[256];
+    for(u32 i=0; i < 256; ++i){
+        f32 c = (f32)i / 255.0f;
+        linear_table[i] = (u16)round_f32_u32(square_f32(c) * 65535.0f);
+    }
+
+    s32 apron_width = bitmap->width + 2;
+    s32 apron_height = bitmap->height + 2;
+    u64* texels = push_array(arena, u64, (u32)(apron_width * apron_height));
+    for(s32 i=0; i < apron_width * apron_height; ++i){
+        texels[i] = 0;
+    }
+
+    Bitmap result = {0};
+    result.width = bitmap->width;
+    result.height = bitmap->height;
+    result.stride = apron_width * (s32)sizeof(u64);
+    result.base = (u8*)(texels + apron_width + 1);
+    result.format = BitmapFormat_Linear16;
+
+    for(s32 y=0; y < bitmap->height; ++y){
+        u32* src = (u32*)(bitmap->base + (y * bitmap->stride));
+        u64* dest = (u64*)(result.base + (y * result.stride));
+        for(s32 x=0; x < bitmap->width; ++x){
+            u32 color = src[x];
+            u32 a = color >> 24;
+            u64 r = ((u64)linear_table[(color >> 16) & 0xFF] * a + 127) / 255;
+            u64 g = ((u64)linear_table[(color >> 8) & 0xFF] * a + 127) / 255;
+            u64 b = ((u64)linear_table[(color >> 0) & 0xFF] * a + 127) / 255;
+            u64 a16 = (u64)a * 257;
+            dest[x] = (a16 << 48) | (r << 32) | (g << 16) | b;
+        }
+    }
+    return(result);
+}
+
+// NOTE: Linear16 mip chain, down to 1x1. Each level is a 2x2 box of the one above it, averaged
+// in linear premultiplied space so edges don't darken. Odd sizes clamp the last row/column
+// instead of pulling in the transparent apron. Costs about a third more texture memory.
+static void
+bitmap_build_mips(Arena* arena, Bitmap* bitmap){
+    assert(bitmap->format == BitmapFormat_Linear16);
+
+    u32 mip_count = 1;
+    for(s32 w=bitmap->width, h=bitmap->height; w > 1 || h > 1; ++mip_count){
+        w = (w > 1) ? w / 2 : 1;
+        h = (h > 1) ? h / 2 : 1;
+    }
+
+    Bitmap* mips = push_array(arena, Bitmap, mip_count);
+    mips[0] = *bitmap;
+    for(u32 level=1; level < mip_count; ++level){
+        Bitmap* src = mips + level - 1;
+        Bitmap* dest = mips + level;
+
+        s32 apron_width = ((src->width > 1) ? src->width / 2 : 1) + 2;
+        s32 apron_height = ((src->height > 1) ? src->height / 2 : 1) + 2;
+        u64* texels = push_array(arena, u64, (u32)(apron_width * apron_height));
+        for(s32 i=0; i < apron_width * apron_height; ++i){
+            texels[i] = 0;
+        }
+
+        *dest = {0};
+        dest->width = apron_width - 2;
+        dest->height = apron_height - 2;
+        dest->stride = apron_width * (s32)sizeof(u64);
+        dest->base = (u8*)(texels + apron_width + 1);
+        dest->format = BitmapFormat_Linear16;
+
+        for(s32 y=0; y < dest->height; ++y){
+            s32 y0 = y * 2;
+            s32 y1 = (y0 + 1 < src->height) ? y0 + 1 : y0;
+            u64* src_row0 = (u64*)(src->base + (y0 * src->stride));
+            u64* src_row1 = (u64*)(src->base + (y1 * src->stride));
+            u64* dest_row = (u64*)(dest->base + (y * dest->stride));
+            for(s32 x=0; x < dest->width; ++x){
+                s32 x0 = x * 2;
+                s32 x1 = (x0 + 1 < src->width) ? x0 + 1 : x0;
+                u64 a = src_row0[x0];
+                u64 b = src_row0[x1];
+                u64 c = src_row1[x0];
+                u64 d = src_row1[x1];
+
+                u64 texel = 0;
+                for(u32 shift=0; shift < 64; shift += 16){
+                    u64 sum = ((a >> shift) & 0xFFFF) + ((b >> shift) & 0xFFFF) +
+                              ((c >> shift) & 0xFFFF) + ((d >> shift) & 0xFFFF);
+                    texel |= ((sum + 2) / 4) << shift;
+                }
+                dest_row[x] = texel;
+            }
+        }
+    }
+
+    for(u32 level=0; level < mip_count; ++level){
+        mips[level].mip_count = mip_count - level;
+        mips[level].mips = mips + level;
+    }
+    *bitmap = mips[0];
+}
+
+// NOTE: Linear16 -> Linear16Block, one level, into a new allocation from arena. Keeps mip_count/mips,
+// the caller relinks those.
+static Bitmap
+bitmap_to_linear16_block(Arena* arena, Bitmap* bitmap){
+    assert(bitmap->format == BitmapFormat_Linear16);
+
+    // NOTE: bilinear footprints start at apron coordinates 0..width, one block per TEXEL_BLOCK_DIM of those
+    s32 blocks_x = (bitmap->width / TEXEL_BLOCK_DIM) + 1;
+    s32 blocks_y = (bitmap->height / TEXEL_BLOCK_DIM) + 1;
+    u8* blocks = push_array(arena, u8, (u32)(blocks_x * blocks_y * TEXEL_BLOCK_BYTES));
+
+    Bitmap result = *bitmap;
+    result.base = blocks;
+    result.stride = blocks_x * TEXEL_BLOCK_BYTES;
+    result.format = BitmapFormat_Linear16Block;
+
+    for(s32 block_y=0; block_y < blocks_y; ++block_y){
+        for(s32 block_x=0; block_x < blocks_x; ++block_x){
+            u64* dest = (u64*)(blocks + (block_y * result.stride) + (block_x * TEXEL_BLOCK_BYTES));
+            for(s32 y=0; y < TEXEL_BLOCK_PITCH; ++y){
+                for(s32 x=0; x < TEXEL_BLOCK_PITCH; ++x){
+                    // NOTE: apron coordinates, anything past the apron is transparent too
+                    s32 apron_x = (block_x * TEXEL_BLOCK_DIM) + x;
+                    s32 apron_y = (block_y * TEXEL_BLOCK_DIM) + y;
+                    u64 texel = 0;
+                    if(apron_x <= bitmap->width + 1 && apron_y <= bitmap->height + 1){
+                        texel = *(u64*)(bitmap->base + ((apron_y - 1) * bitmap->stride) + ((apron_x - 1) * (s32)sizeof(u64)));
+                    }
+                    dest[(y * TEXEL_BLOCK_PITCH) + x] = texel;
+                }
+            }
+        }
+    }
+    return(result);
+}
+
 // CONSIDER: do we need to pass in arena here? and if we do, why don't we use it to allocate an arena type instead of using it for os_file_read()
 static Bitmap
-load_bitmap(Arena *arena, String8 dir, String8 file_name){
+load_bitmap(Arena *arena, String8 dir, String8 file_name, BitmapFormat format = BitmapFormat_Premultiplied){
     Bitmap result = {0};
 
     FileData bitmap_file;
@@ -112,16 +318,16 @@ load_bitmap(Arena *arena, String8 dir, String8 file_name){
 
         // NOTE: As bmps can have ARGB or RGBA or ..., we need to find where our color
         // shifts are and position the each 8 bit into a ARGB format.
-        BitScanResult red_shift;
-        BitScanResult green_shift;
-        BitScanResult blue_shift;
-        BitScanResult alpha_shift;
+        BitScanResult red_shift = {0};
+        BitScanResult green_shift = {0};
+        BitScanResult blue_shift = {0};
+        BitScanResult alpha_shift = {0};
         if(header->Compression == 3){
             u32 alpha_mask = ~(header->RedMask | header->GreenMask | header->BlueMask);
-            BitScanResult red_shift = find_first_set_bit(header->RedMask);
-            BitScanResult green_shift = find_first_set_bit(header->GreenMask);
-            BitScanResult blue_shift = find_first_set_bit(header->BlueMask);
-            BitScanResult alpha_shift = find_first_set_bit(alpha_mask);
+            red_shift = find_first_set_bit(header->RedMask);
+            green_shift = find_first_set_bit(header->GreenMask);
+            blue_shift = find_first_set_bit(header->BlueMask);
+            alpha_shift = find_first_set_bit(alpha_mask);
 
             assert(alpha_shift.found);
             assert(red_shift.found);
@@ -129,46 +335,39 @@ load_bitmap(Arena *arena, String8 dir, String8 file_name){
             assert(blue_shift.found);
         }
 
+        // NOTE: straight ARGB in place first, then whatever format was asked for
         u32* pixel = (u32*)result.base;
         for(s32 y=0; y < result.height; ++y){
             for(s32 x=0; x < result.width; ++x){
-                // get u32 color. shift colors out of correct location
-                u32 color_u32 = *pixel;
                 if(header->Compression == 3){
-                    u32 color_u32 = ((((*pixel >> alpha_shift.index) & 0xFF) << 24) |
-                                     (((*pixel >> red_shift.index) & 0xFF)   << 16) |
-                                     (((*pixel >> green_shift.index) & 0xFF)  << 8) |
-                                     (((*pixel >> blue_shift.index) & 0xFF)   << 0));
+                    *pixel = ((((*pixel >> alpha_shift.index) & 0xFF) << 24) |
+                              (((*pixel >> red_shift.index) & 0xFF)   << 16) |
+                              (((*pixel >> green_shift.index) & 0xFF)  << 8) |
+                              (((*pixel >> blue_shift.index) & 0xFF)   << 0));
                 }
+                pixel++;
+            }
+        }
+        result.format = BitmapFormat_Straight;
 
-                // u32 to RGBA
-                RGBA color = {
-                    .a = ((f32)((color_u32 >> 24) & 0xFF) / 255.0f),
-                    .r = ((f32)((color_u32 >> 16) & 0xFF) / 255.0f),
-                    .g = ((f32)((color_u32 >> 8) & 0xFF) / 255.0f),
-                    .b = ((f32)((color_u32 >> 0) & 0xFF) / 255.0f),
-                };
-
-                // SRGB to linear
-                color.r = square_f32(color.r),
-                color.g = square_f32(color.g),
-                color.b = square_f32(color.b),
-
-                // gamma correction
-                color.rgb *= color.a;
-
-                // linear to SRGB
-                color.r = sqrt_f32(color.r),
-                color.g = sqrt_f32(color.g),
-                color.b = sqrt_f32(color.b),
-
-                // write pixel
-                *pixel++ = (u32)(round_f32_u32(color.a * 255.0f) << 24 |
-                                 round_f32_u32(color.r * 255.0f) << 16 |
-                                 round_f32_u32(color.g * 255.0f) << 8 |
-                                 round_f32_u32(color.b * 255.0f) << 0);
+        if(format == BitmapFormat_Premultiplied){
+            bitmap_premultiply(&result);
+        }
+        else if(format == BitmapFormat_Linear16 || format == BitmapFormat_Linear16Block){
+            result = bitmap_to_linear16(arena, &result);
+            bitmap_build_mips(arena, &result);
+            if(format == BitmapFormat_Linear16Block){
+                for(u32 level=0; level < result.mip_count; ++level){
+                    result.mips[level] = bitmap_to_linear16_block(arena, result.mips + level);
+                }
+                result = result.mips[0];
             }
         }
+
+        result.generation = bitmap_new_generation();
+        for(u32 level=0; level < result.mip_count; ++level){
+            result.mips[level].generation = result.generation;
+        }
     }
     return(result);
 }
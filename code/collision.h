@@ -0,0 +1,178 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+// NOTE: Broad phase is a uniform grid rebuilt every tick. Each collider goes into the one cell
+// holding its center, and cells are at least as wide as the biggest collider's diameter, so two
+// overlapping circles always sit in the same or adjacent cells. Walking each cell against itself
+// and its four forward neighbours (E, SW, S, SE) visits every nearby pair exactly once, which
+// keeps the whole thing roughly linear in the number of colliders. Positions and colliders get
+// copied into cell order while building, so that walk streams through memory, and since cells
+// are row major the forward neighbours are just two contiguous runs of items: the rest of this
+// cell plus E, and SW..SE on the next row.
+// Pairs across the wrap seam aren't reported, the playfield margin keeps that offscreen.
+typedef enum {CollisionLayer_Ship = 1 << 0, CollisionLayer_Asteroid = 1 << 1, CollisionLayer_Bullet = 1 << 2} CollisionLayer;
+
+// NOTE: a pair is only considered if one side's layer is in the other side's mask,
+// layer 0 means the body doesn't collide at all
+typedef struct Collider{
+    f32 radius;
+    u16 layer;
+    u16 mask;
+} Collider;
+
+typedef struct CollisionPair{
+    u32 a;
+    u32 b;
+} CollisionPair;
+
+#define SPATIAL_GRID_CELLS_MAX (1 << 16)
+
+typedef struct SpatialGrid{
+    Rect bounds;
+    f32 cell_size;
+    s32 width;
+    s32 height;
+    u32* cell_start; // NOTE: width*height + 1 offsets into items, cell c is [cell_start[c], cell_start[c + 1])
+    u32* items;      // NOTE: body indices grouped by cell
+    f32* x;          // NOTE: x, y and colliders are in items order
+    f32* y;
+    Collider* colliders;
+} SpatialGrid;
+
+static bool
+colliders_interact(Collider a, Collider b){
+    bool result = ((a.layer & b.mask) != 0) || ((b.layer & a.mask) != 0);
+    return(result);
+}
+
+// NOTE: counting sort of the bodies into cells, two passes over the bodies and one over the cells
+static SpatialGrid
+spatial_grid_build(Arena* arena, f32* x, f32* y, Collider* colliders, u32 count, Rect bounds, f32 cell_size){
+    SpatialGrid result = {0};
+    result.bounds = bounds;
+
+    f32 max_radius = 0;
+    for(u32 i=0; i < count; ++i){
+        if(colliders[i].layer && colliders[i].radius > max_radius){
+            max_radius = colliders[i].radius;
+        }
+    }
+    f32 bounds_width = bounds.x1 - bounds.x0;
+    f32 bounds_height = bounds.y1 - bounds.y0;
+    cell_size = cell_size > max_radius * 2 ? cell_size : max_radius * 2;
+    cell_size = cell_size > 1.0f ? cell_size : 1.0f;
+    while((bounds_width / cell_size + 1) * (bounds_height / cell_size + 1) > SPATIAL_GRID_CELLS_MAX){
+        cell_size *= 2;
+    }
+    result.cell_size = cell_size;
+    result.width = (s32)(bounds_width / cell_size) + 1;
+    result.height = (s32)(bounds_height / cell_size) + 1;
+
+    u32 cell_count = (u32)(result.width * result.height);
+    result.cell_start = push_array(arena, u32, cell_count + 1);
+    result.items = push_array(arena, u32, count);
+    result.x = push_array(arena, f32, count);
+    result.y = push_array(arena, f32, count);
+    result.colliders = push_array(arena, Collider, count);
+    u32* body_cell = push_array(arena, u32, count);
+    for(u32 c=0; c <= cell_count; ++c){
+        result.cell_start[c] = 0;
+    }
+
+    // NOTE: clamping out of bounds bodies into the border cells keeps neighbours within one cell
+    f32 inv_cell_size = 1.0f / cell_size;
+    for(u32 i=0; i < count; ++i){
+        if(!colliders[i].layer){
+            continue;
+        }
+        s32 cx = (s32)((x[i] - bounds.x0) * inv_cell_size);
+        s32 cy = (s32)((y[i] - bounds.y0) * inv_cell_size);
+        cx = cx < 0 ? 0 : (cx >= result.width ? result.width - 1 : cx);
+        cy = cy < 0 ? 0 : (cy >= result.height ? result.height - 1 : cy);
+        u32 cell = (u32)(cy * result.width + cx);
+        body_cell[i] = cell;
+        result.cell_start[cell + 1]++;
+    }
+    for(u32 c=0; c < cell_count; ++c){
+        result.cell_start[c + 1] += result.cell_start[c];
+    }
+
+    // NOTE: cell_start[c] doubles as the write cursor and ends up at the start of cell c + 1,
+    // shift back afterwards
+    for(u32 i=0; i < count; ++i){
+        if(colliders[i].layer){
+            u32 at = result.cell_start[body_cell[i]]++;
+            result.items[at] = i;
+            result.x[at] = x[i];
+            result.y[at] = y[i];
+            result.colliders[at] = colliders[i];
+        }
+    }
+    for(u32 c=cell_count; c > 0; --c){
+        result.cell_start[c] = result.cell_start[c - 1];
+    }
+    result.cell_start[0] = 0;
+    return(result);
+}
+
+// NOTE: tests grid item i against items [start, end). Most tests fail in no particular pattern,
+// so rather than branch on the result every pair gets written to the next free spot and the
+// count only moves on hits. pairs needs one spare entry past capacity for that.
+static void
+spatial_grid_overlaps_run(SpatialGrid* grid, u32 i, u32 start, u32 end, CollisionPair* pairs, u32 capacity, u32* pair_count){
+    Collider a = grid->colliders[i];
+    f32 ax = grid->x[i];
+    f32 ay = grid->y[i];
+    u32 a_index = grid->items[i];
+    u32 count = *pair_count;
+    for(u32 j=start; j < end; ++j){
+        Collider b = grid->colliders[j];
+        f32 dx = grid->x[j] - ax;
+        f32 dy = grid->y[j] - ay;
+        f32 radii = a.radius + b.radius;
+        u32 hit = (u32)colliders_interact(a, b) & (u32)((dx*dx + dy*dy) < radii*radii);
+        u32 at = count < capacity ? count : capacity;
+        pairs[at].a = a_index;
+        pairs[at].b = grid->items[j];
+        count += hit;
+    }
+    *pair_count = count;
+}
+
+// NOTE: pairs of bodies whose layers interact and whose circles overlap, as body indices. Returns
+// how many there were, which can be more than capacity (only capacity get written). pairs has
+// to hold capacity + 1.
+static u32
+spatial_grid_overlaps(SpatialGrid* grid, CollisionPair* pairs, u32 capacity){
+    u32 pair_count = 0;
+    for(s32 cy=0; cy < grid->height; ++cy){
+        for(s32 cx=0; cx < grid->width; ++cx){
+            u32 cell = (u32)(cy * grid->width + cx);
+            u32 start = grid->cell_start[cell];
+            u32 end = grid->cell_start[cell + 1];
+            if(start == end){
+                continue;
+            }
+
+            // NOTE: this cell and E
+            u32 same_row_end = (cx + 1 < grid->width) ? grid->cell_start[cell + 2] : end;
+            // NOTE: SW, S and SE
+            u32 next_row_start = 0;
+            u32 next_row_end = 0;
+            if(cy + 1 < grid->height){
+                s32 x0 = cx > 0 ? cx - 1 : 0;
+                s32 x1 = cx + 1 < grid->width ? cx + 1 : cx;
+                next_row_start = grid->cell_start[(cy + 1) * grid->width + x0];
+                next_row_end = grid->cell_start[(cy + 1) * grid->width + x1 + 1];
+            }
+
+            for(u32 i=start; i < end; ++i){
+                spatial_grid_overlaps_run(grid, i, i + 1, same_row_end, pairs, capacity, &pair_count);
+                spatial_grid_overlaps_run(grid, i, next_row_start, next_row_end, pairs, capacity, &pair_count);
+            }
+        }
+    }
+    return(pair_count);
+}
+
+#endif
@@ -61,8 +61,12 @@ command_exit(String8* args){
 
 static void
 command_load(String8* args){
-    deserialize_data(pm, *args);
-    console_store_output(str8_format(global_arena, "loading from file: %s", args->str));
+    if(deserialize_data(pm, *args)){
+        console_store_output(str8_format(global_arena, "loading from file: %s", args->str));
+    }
+    else{
+        console_store_output(str8_format(global_arena, "failed to load file: %s", args->str));
+    }
 }
 
 static void
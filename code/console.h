@@ -153,16 +153,16 @@ input_add_char(u8 c){
             console.cursor_index++;
             console.input_char_count++;
             Glyph glyph = console.input_font.glyphs[c];
-            console.cursor_rect.x0 += ((f32)glyph.advance_width * console.input_font.scale);
-            console.cursor_rect.x1 += ((f32)glyph.advance_width * console.input_font.scale);
+            console.cursor_rect.x0 += glyph.advance;
+            console.cursor_rect.x1 += glyph.advance;
         }
         else{
             console.input[console.input_char_count++] = c;
             console.cursor_index++;
 
             Glyph glyph = console.input_font.glyphs[c];
-            console.cursor_rect.x0 += ((f32)glyph.advance_width * console.input_font.scale);
-            console.cursor_rect.x1 += ((f32)glyph.advance_width * console.input_font.scale);
+            console.cursor_rect.x0 += glyph.advance;
+            console.cursor_rect.x1 += glyph.advance;
         }
     }
 }
@@ -196,16 +196,16 @@ input_remove_char(){
             }
 
             Glyph glyph = console.input_font.glyphs[c];
-            console.cursor_rect.x0 -= ((f32)glyph.advance_width * console.input_font.scale);
-            console.cursor_rect.x1 -= ((f32)glyph.advance_width * console.input_font.scale);
+            console.cursor_rect.x0 -= glyph.advance;
+            console.cursor_rect.x1 -= glyph.advance;
         }
         else{
             u8 c = console.input[--console.input_char_count];
             console.cursor_index--;
 
             Glyph glyph = console.input_font.glyphs[c];
-            console.cursor_rect.x0 -= ((f32)glyph.advance_width * console.input_font.scale);
-            console.cursor_rect.x1 -= ((f32)glyph.advance_width * console.input_font.scale);
+            console.cursor_rect.x0 -= glyph.advance;
+            console.cursor_rect.x1 -= glyph.advance;
         }
     }
 }
@@ -266,7 +266,7 @@ push_console(Arena* command_arena){
 static void
 update_console(){
     // lerp to appropriate position based on state. Everything is positioned based on output_rect.
-    f32 lerp_speed =  console_speed * (f32)clock.dt;
+    f32 lerp_speed =  console_speed * (f32)game_clock.dt;
     f32 output_rect_bottom = 0;
     switch(console.state){
         case CLOSED:{
@@ -315,8 +315,8 @@ handle_console_event(Event event){
                 for(u32 i=console.cursor_index; i < console.input_char_count; ++i){
                     u8 c = console.input[i];
                     Glyph glyph = console.input_font.glyphs[c];
-                    console.cursor_rect.x0 += ((f32)glyph.advance_width * console.input_font.scale);
-                    console.cursor_rect.x1 += ((f32)glyph.advance_width * console.input_font.scale);
+                    console.cursor_rect.x0 += glyph.advance;
+                    console.cursor_rect.x1 += glyph.advance;
                     console.cursor_index++;
                 }
             }
@@ -324,8 +324,8 @@ handle_console_event(Event event){
                 if(console.cursor_index < console.input_char_count){
                     u8 c = console.input[console.cursor_index];
                     Glyph glyph = console.input_font.glyphs[c];
-                    console.cursor_rect.x0 += ((f32)glyph.advance_width * console.input_font.scale);
-                    console.cursor_rect.x1 += ((f32)glyph.advance_width * console.input_font.scale);
+                    console.cursor_rect.x0 += glyph.advance;
+                    console.cursor_rect.x1 += glyph.advance;
                     console.cursor_index++;
                 }
             }
@@ -334,8 +334,8 @@ handle_console_event(Event event){
                     console.cursor_index--;
                     u8 c = console.input[console.cursor_index];
                     Glyph glyph = console.input_font.glyphs[c];
-                    console.cursor_rect.x0 -= ((f32)glyph.advance_width * console.input_font.scale);
-                    console.cursor_rect.x1 -= ((f32)glyph.advance_width * console.input_font.scale);
+                    console.cursor_rect.x0 -= glyph.advance;
+                    console.cursor_rect.x1 -= glyph.advance;
                 }
             }
             if(event.keycode == ARROW_UP){
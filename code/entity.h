@@ -2,7 +2,7 @@
 #define ENTITY_H
 
 typedef enum {EntityFlag_Movable} EntityFlags;
-typedef enum {EntityType_None, EntityType_Object, EntityType_Pixel, EntityType_Line, EntityType_Ray, EntityType_Segment, EntityType_Triangle, EntityType_Rect, EntityType_Quad, EntityType_Box, EntityType_Circle, EntityType_Bitmap, EntityType_Glyph, EntityType_Basis, EntityType_Ship} EntityType;
+typedef enum {EntityType_None, EntityType_Object, EntityType_Pixel, EntityType_Line, EntityType_Ray, EntityType_Segment, EntityType_Triangle, EntityType_Rect, EntityType_Quad, EntityType_Box, EntityType_Circle, EntityType_Bitmap, EntityType_Glyph, EntityType_Basis, EntityType_Ship, EntityType_Asteroid, EntityType_Bullet} EntityType;
 
 typedef struct Entity{
     u32 index;
@@ -13,7 +13,6 @@ typedef struct Entity{
     u32 flags;
     Rect rect;
     f32 scale;
-    v2 origin;
     v2 x_axis;
     v2 y_axis;
     RGBA color;
@@ -23,18 +22,15 @@ typedef struct Entity{
     f32 start_position;
 
 
-    v2 direction;
-    f32 rad;
-
-    f32 speed;
+    // NOTE: origin, rotation and motion live in the EntityStore hot arrays, see EntityBody
+    v2 direction; // NOTE: lines/rays
+    f32 rad;      // NOTE: circle radius
 
     v2 p0 = p0;
     v2 p1 = p1;
     v2 p2 = p2;
     v2 p3 = p3;
 
-    f32 velocity;
-
     bool draw;
     bool fill;
 
@@ -43,6 +39,18 @@ typedef struct Entity{
     bool render;
 } Entity;
 
+// NOTE: value view of one entity's hot fields, for code that handles a single entity at a time.
+// Systems that sweep every entity go straight at the EntityStore arrays instead.
+typedef struct EntityBody{
+    v2 origin;
+    f32 rad;
+    f32 angular_velocity;
+    f32 velocity; // NOTE: 0..1 fraction of speed
+    f32 thrust;
+    f32 drag;
+    f32 speed;
+} EntityBody;
+
 static bool
 has_flags(Entity *e, u32 flags){
     return(e->flags & flags);
@@ -93,12 +93,19 @@ draw_string(RenderBuffer* rb, v2 pos, String8 string, u32 color){
 #pragma clang diagnostic pop
 
 typedef struct Glyph{
-    Bitmap bitmap;
+    s32 atlas_y;
     s32 advance_width, lsb;
+    f32 advance; // NOTE: advance_width * scale
     s32 x0, y0, x1, y1;
     s32 w, h, xoff, yoff;
 } Glyph;
 
+// NOTE: columns of an atlas row that have coverage, x0 == x1 for empty rows
+typedef struct AtlasSpan{
+    s16 x0;
+    s16 x1;
+} AtlasSpan;
+
 typedef struct Font{
     stbtt_fontinfo info;
     f32 scale;
@@ -107,6 +114,14 @@ typedef struct Font{
 
     Glyph glyphs[128];
 
+    // NOTE: unscaled kern advance for every pair in the loaded range, [left][right]
+    s16* kern_table;
+
+    // NOTE: 8-bit coverage, one byte per texel. Glyphs are stacked bottom-up on top of each
+    // other so every atlas row belongs to exactly one glyph and can have its own span.
+    Bitmap atlas;
+    AtlasSpan* atlas_spans;
+
     String8 name;
     RGBA color;
     f32 size;
@@ -122,46 +137,92 @@ load_font_ttf(Arena* arena, String8 dir, Font* font){
     return(true);
 }
 
-// TODO: change this to load a baked bitmap, and use UV to access correct glyph
+#define FONT_FIRST_CHAR ' '
+#define FONT_LAST_CHAR  '~'
+#define FONT_CHAR_COUNT (FONT_LAST_CHAR - FONT_FIRST_CHAR + 1)
+
 static void
 load_font_glyphs(Arena* arena, Font* font){
     stbtt_GetFontVMetrics(&font->info, &font->ascent, &font->descent, &font->line_gap);
     font->vertical_offset = font->ascent - font->descent + font->line_gap;
     font->scale = stbtt_ScaleForPixelHeight(&font->info, font->size);
 
-    for(s32 c=' '; c<='~'; ++c){
+    // size the atlas
+    s32 atlas_width = 0;
+    s32 atlas_height = 0;
+    for(s32 c=FONT_FIRST_CHAR; c<=FONT_LAST_CHAR; ++c){
         Glyph* glyph = font->glyphs + c;
+        stbtt_GetCodepointBitmapBox(&font->info, c, font->scale, font->scale, &glyph->x0,&glyph->y0,&glyph->x1,&glyph->y1);
 
-        u8* codepoint_bitmap = stbtt_GetCodepointBitmap(&font->info, 0, font->scale, c, &glyph->w, &glyph->h, &glyph->xoff, &glyph->yoff);
+        s32 w = glyph->x1 - glyph->x0;
+        s32 h = glyph->y1 - glyph->y0;
+        if(w > atlas_width){ atlas_width = w; }
+        atlas_height += h;
+    }
 
-        glyph->bitmap.width = glyph->w;
-        glyph->bitmap.height = glyph->h;
-        glyph->bitmap.base = push_array(arena, u8, (u32)(glyph->w*glyph->h*4));
+    font->atlas.width = atlas_width;
+    font->atlas.height = atlas_height;
+    font->atlas.stride = atlas_width;
+    font->atlas.base = push_array(arena, u8, (u32)(atlas_width * atlas_height));
+    font->atlas_spans = push_array(arena, AtlasSpan, (u32)atlas_height);
 
-        // get codepoint info
+    s32 atlas_y = 0;
+    for(s32 c=FONT_FIRST_CHAR; c<=FONT_LAST_CHAR; ++c){
+        Glyph* glyph = font->glyphs + c;
+
+        u8* codepoint_bitmap = stbtt_GetCodepointBitmap(&font->info, 0, font->scale, c, &glyph->w, &glyph->h, &glyph->xoff, &glyph->yoff);
         stbtt_GetCodepointHMetrics(&font->info, c, &glyph->advance_width, &glyph->lsb);
-        stbtt_GetCodepointBitmapBox(&font->info, c, font->scale, font->scale, &glyph->x0,&glyph->y0,&glyph->x1,&glyph->y1);
+        glyph->advance = (f32)glyph->advance_width * font->scale;
+        glyph->atlas_y = atlas_y;
 
-        u8* dest_row = (u8*)glyph->bitmap.base + (glyph->h - 1) * (glyph->w * 4);
+        // stb rows go top-down, atlas rows go bottom-up
+        u8* src_row = codepoint_bitmap + (glyph->h - 1) * glyph->w;
         for(s32 y=0; y < glyph->h; ++y){
-            u32* dest = (u32*)dest_row;
+            u8* dest = (u8*)font->atlas.base + ((atlas_y + y) * font->atlas.stride);
+            AtlasSpan* span = font->atlas_spans + atlas_y + y;
+            span->x0 = 0;
+            span->x1 = 0;
+
             for(s32 x=0; x < glyph->w; ++x){
-                u8 alpha = *codepoint_bitmap++;
-                f32 linear_alpha = alpha/255.0f;
-                RGBA c = {font->color.r, font->color.g, font->color.b, (f32)alpha};
+                u8 alpha = src_row[x];
+                dest[x] = alpha;
+                if(alpha){
+                    if(span->x0 == span->x1){ span->x0 = (s16)x; }
+                    span->x1 = (s16)(x + 1);
+                }
+            }
+            src_row -= glyph->w;
+        }
+        atlas_y += glyph->h;
+
+        stbtt_FreeBitmap(codepoint_bitmap, 0);
+    }
+    font->atlas.generation = bitmap_new_generation();
 
-                *dest++ = ((u32)((alpha) << 24) |
-                          ((u32)(c.r * 255.0f) << 16) |
-                          ((u32)(c.g * 255.0f) <<  8) |
-                          ((u32)(c.b * 255.0f) <<  0));
-                //*dest++ = (u32)((alpha << 24) | 0xFFFFFF);
+    // kerning, looked up once here so text layout never has to search the kern/GPOS tables
+    s32 glyph_indices[FONT_CHAR_COUNT];
+    for(s32 i=0; i < FONT_CHAR_COUNT; ++i){
+        glyph_indices[i] = stbtt_FindGlyphIndex(&font->info, FONT_FIRST_CHAR + i);
+    }
 
-            }
-            dest_row -= glyph->w * 4;
+    font->kern_table = push_array(arena, s16, FONT_CHAR_COUNT * FONT_CHAR_COUNT);
+    for(s32 left=0; left < FONT_CHAR_COUNT; ++left){
+        for(s32 right=0; right < FONT_CHAR_COUNT; ++right){
+            s32 kern = stbtt_GetGlyphKernAdvance(&font->info, glyph_indices[left], glyph_indices[right]);
+            font->kern_table[(left * FONT_CHAR_COUNT) + right] = (s16)kern;
         }
     }
 }
 
+static s32
+font_kern(Font* font, u8 left, u8 right){
+    s32 result = 0;
+    if(left >= FONT_FIRST_CHAR && left <= FONT_LAST_CHAR && right >= FONT_FIRST_CHAR && right <= FONT_LAST_CHAR){
+        result = font->kern_table[((left - FONT_FIRST_CHAR) * FONT_CHAR_COUNT) + (right - FONT_FIRST_CHAR)];
+    }
+    return(result);
+}
+
 static s32
 string_width_in_pixels(String8 str, Font* font){
     s32 result = 0;
@@ -169,6 +230,9 @@ string_width_in_pixels(String8 str, Font* font){
         u8* c = str.str + i;
         Glyph* glyph = font->glyphs + *c;
         result += glyph->advance_width;
+        if(i + 1 < str.size){
+            result += font_kern(font, *c, str.str[i + 1]);
+        }
     }
     return(round_f32_s32((f32)result * font->scale));
 }
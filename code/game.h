@@ -8,6 +8,8 @@
 #include "renderer.h"
 
 #include "entity.h"
+#include "kinematics.h"
+#include "collision.h"
 
 static Font global_font = {0};
 
@@ -25,7 +27,44 @@ static RGBA WHITE =   {1.0f, 1.0f, 1.0f,  1.0f};
 static RGBA BLACK =   {0.0f, 0.0f, 0.0f,  1.0f};
 static RGBA ARMY_GREEN =   {0.25f, 0.25f, 0.23f,  1.0f};
 
-#define ENTITIES_MAX 100
+// NOTE: Live entities are kept packed in entities[0, count) so update/render is a straight
+// linear pass. Removal swaps the last entity into the hole. Handles index a sparse slot, which
+// maps to the entity's current dense position and holds its generation, so lookups stay O(1).
+// Entity* is only good until the next remove_entity(), hold on to an EntityHandle instead.
+// Address space for ENTITIES_RESERVE slots is reserved once at init and pages get committed
+// ENTITIES_COMMIT_STEP slots at a time as they are handed out.
+// The fields the simulation touches every step are pulled out of Entity into one f32 array each
+// (hot[EntityHot_*]), indexed like entities[], so sweeps stream through contiguous floats.
+#define ENTITIES_RESERVE (1 << 20)
+#define ENTITIES_COMMIT_STEP 4096
+typedef enum {EntityHot_X, EntityHot_Y, EntityHot_PrevX, EntityHot_PrevY, EntityHot_Rad, EntityHot_PrevRad, EntityHot_AngularVelocity, EntityHot_Velocity, EntityHot_Thrust, EntityHot_Drag, EntityHot_Speed, EntityHot_Count} EntityHotField;
+
+typedef struct EntityStore{
+    Entity* entities;   // NOTE: dense
+    f32* hot[EntityHot_Count]; // NOTE: dense, prev_* is the previous sim step for interpolation
+    Collider* colliders;       // NOTE: dense
+    u32* dense;         // NOTE: slot -> index into entities
+    u32* generation;    // NOTE: slot -> generation, bumped on remove so old handles go stale
+    u32* free_slots;
+    u32 free_count;
+
+    u32 slots_used; // NOTE: slots handed out at least once
+    u32 committed;  // NOTE: slots backed by committed pages
+    u32 reserved;
+    u32 count;      // NOTE: live entities
+
+    MemoryCommit* commit;
+} EntityStore;
+
+#define PLAYFIELD_MARGIN 64.0f
+#define COLLISION_CELL_SIZE 64.0f // NOTE: about an asteroid's diameter, the grid widens it for anything bigger
+#define COLLISION_PAIRS_PER_ENTITY 8
+#define SHIP_SCALE 50.0f
+#define ASTEROID_SCALE 64.0f
+#define ASTEROID_SPEED 60.0f
+#define ASTEROID_SPAWN_COUNT 6
+#define BULLET_SCALE 8.0f
+#define BULLET_SPEED 600.0f
 typedef struct PermanentMemory{
     Arena arena;
     String8 cwd; // CONSIDER: this might be something we want to be set on the platform side
@@ -34,17 +73,18 @@ typedef struct PermanentMemory{
     String8 sprites_dir; // CONSIDER: this might be something we want to be set on the platform side
     String8 saves_dir; // CONSIDER: this might be something we want to be set on the platform side
 
-    u32 generation[ENTITIES_MAX];
-    u32 free_entities[ENTITIES_MAX];
-    u32 free_entities_at;
-
-    Entity entities[ENTITIES_MAX];
-    u32 entities_count;
-
-    Entity* texture;
-    Entity* circle;
-    Entity* basis;
-    Entity* ship;
+    EntityStore entity_store;
+    Rect playfield; // NOTE: bodies wrap around this
+
+    EntityHandle texture;
+    EntityHandle circle;
+    EntityHandle basis;
+    EntityHandle ship;
+    // NOTE: textures live in pm->arena for the whole run, in-flight render commands point at
+    // their texels and mips so they can't be reloaded or freed under the render thread
+    Bitmap ship_texture;
+    Bitmap asteroid_texture;
+    Bitmap bullet_texture;
     Bitmap tree;
     bool ship_loaded;
 
@@ -58,13 +98,90 @@ typedef struct TransientMemory{
 } TransientMemory;
 global TransientMemory* tm;
 
+// NOTE: on failure the store is left with no capacity and add_entity() returns 0
+static bool
+entity_store_init(EntityStore* store, Memory* memory){
+    store->entities = 0;
+    for(u32 field=0; field < EntityHot_Count; ++field){
+        store->hot[field] = 0;
+    }
+    store->colliders = 0;
+    store->dense = 0;
+    store->generation = 0;
+    store->free_slots = 0;
+    store->free_count = 0;
+    store->slots_used = 0;
+    store->committed = 0;
+    store->reserved = 0;
+    store->count = 0;
+    store->commit = memory->commit;
+
+    size_t entities_size = (size_t)ENTITIES_RESERVE * sizeof(Entity);
+    size_t slots_size = (size_t)ENTITIES_RESERVE * sizeof(u32);
+    size_t hot_size = (size_t)ENTITIES_RESERVE * sizeof(f32);
+    size_t colliders_size = (size_t)ENTITIES_RESERVE * sizeof(Collider);
+    u8* base = (u8*)memory->reserve(entities_size + slots_size * 3 + hot_size * EntityHot_Count + colliders_size);
+    if(!base){
+        return(false);
+    }
+
+    store->entities = (Entity*)base;
+    store->dense = (u32*)(base + entities_size);
+    store->generation = (u32*)(base + entities_size + slots_size);
+    store->free_slots = (u32*)(base + entities_size + slots_size * 2);
+    u8* hot_base = base + entities_size + slots_size * 3;
+    for(u32 field=0; field < EntityHot_Count; ++field){
+        store->hot[field] = (f32*)(hot_base + hot_size * field);
+    }
+    store->colliders = (Collider*)(hot_base + hot_size * EntityHot_Count);
+    store->reserved = ENTITIES_RESERVE;
+    return(true);
+}
+
+static bool
+entity_store_grow(EntityStore* store){
+    if(store->committed >= store->reserved){
+        return(false);
+    }
+
+    u32 count = store->reserved - store->committed;
+    count = count < ENTITIES_COMMIT_STEP ? count : ENTITIES_COMMIT_STEP;
+    u32 at = store->committed;
+    // NOTE: live entities never outnumber slots handed out, so the dense array grows in step
+    // NOTE: freshly committed pages come back zeroed, so new generations start at 0
+    if(!store->commit(store->entities + at, count * sizeof(Entity)) ||
+       !store->commit(store->dense + at, count * sizeof(u32)) ||
+       !store->commit(store->generation + at, count * sizeof(u32)) ||
+       !store->commit(store->free_slots + at, count * sizeof(u32))){
+        return(false);
+    }
+    for(u32 field=0; field < EntityHot_Count; ++field){
+        if(!store->commit(store->hot[field] + at, count * sizeof(f32))){
+            return(false);
+        }
+    }
+    if(!store->commit(store->colliders + at, count * sizeof(Collider))){
+        return(false);
+    }
+    store->committed += count;
+    return(true);
+}
+
+static void
+entity_store_bump_generation(EntityStore* store, u32 slot){
+    store->generation[slot]++;
+    if(store->generation[slot] == 0){
+        store->generation[slot] = 1; // NOTE: 0 is never a live generation
+    }
+}
+
 static Entity*
 entity_from_handle(PermanentMemory* pm, EntityHandle handle){
+    EntityStore* store = &pm->entity_store;
     Entity *result = 0;
-    if(handle.index < (s32)array_count(pm->entities)){
-        Entity *e = pm->entities + handle.index;
-        if(e->generation == handle.generation){
-            result = e;
+    if(handle.index < store->slots_used && handle.generation != 0){
+        if(store->generation[handle.index] == handle.generation){
+            result = store->entities + store->dense[handle.index];
         }
     }
     return(result);
@@ -74,215 +191,486 @@ static EntityHandle
 handle_from_entity(PermanentMemory* pm, Entity *e){
     assert(e != 0);
     EntityHandle result = {0};
-    if((e >= pm->entities) && (e < (pm->entities + array_count(pm->entities)))){
+    EntityStore* store = &pm->entity_store;
+    if((e >= store->entities) && (e < (store->entities + store->count))){
         result.index = e->index;
         result.generation = e->generation;
     }
     return(result);
 }
 
+// NOTE: moves the last entity into e's place, so don't hold other Entity* across this
 static void
 remove_entity(PermanentMemory* pm, Entity* e){
-    e->type = EntityType_None;
-    pm->free_entities[++pm->free_entities_at] = e->index;
-    pm->entities_count--;
-    e->index = 0;
-    e->generation = 0;
+    EntityStore* store = &pm->entity_store;
+    assert((e >= store->entities) && (e < (store->entities + store->count)));
+    u32 slot = e->index;
+    entity_store_bump_generation(store, slot);
+    store->free_slots[store->free_count++] = slot;
+
+    Entity* last = store->entities + --store->count;
+    if(e != last){
+        u32 dense_index = (u32)(e - store->entities);
+        u32 last_index = store->count;
+        *e = *last;
+        for(u32 field=0; field < EntityHot_Count; ++field){
+            store->hot[field][dense_index] = store->hot[field][last_index];
+        }
+        store->colliders[dense_index] = store->colliders[last_index];
+        store->dense[e->index] = dense_index;
+    }
+    last->type = EntityType_None;
 }
 
+// NOTE: returns 0 when the reservation is full or pages can't be committed, callers have to check
 static Entity*
 add_entity(PermanentMemory *pm, EntityType type){
-    if(pm->free_entities_at < ENTITIES_MAX){
-        u32 free_entity_index = pm->free_entities[pm->free_entities_at--];
-        Entity *e = pm->entities + free_entity_index;
-        e->index = free_entity_index;
-        pm->generation[e->index]++;
-        pm->entities_count++;
-        e->generation = pm->generation[e->index]; // CONSIDER: this might not be necessary
-        e->type = type;
+    EntityStore* store = &pm->entity_store;
+    u32 slot = 0;
+    if(store->free_count){
+        slot = store->free_slots[--store->free_count];
+    }
+    else{
+        if(store->slots_used == store->committed && !entity_store_grow(store)){
+            return(0);
+        }
+        slot = store->slots_used++;
+    }
+    if(store->generation[slot] == 0){
+        store->generation[slot] = 1;
+    }
+
+    u32 dense_index = store->count++;
+    Entity *e = store->entities + dense_index;
+    u8* bytes = (u8*)e;
+    for(u32 i=0; i < sizeof(Entity); ++i){
+        bytes[i] = 0;
+    }
+    for(u32 field=0; field < EntityHot_Count; ++field){
+        store->hot[field][dense_index] = 0;
+    }
+    store->colliders[dense_index] = {0};
+
+    store->dense[slot] = dense_index;
+    e->index = slot;
+    e->generation = store->generation[slot];
+    e->type = type;
+    return(e);
+}
+
+static EntityBody
+entity_body(PermanentMemory* pm, Entity* e){
+    EntityStore* store = &pm->entity_store;
+    u32 i = (u32)(e - store->entities);
+    EntityBody result = {
+        .origin = make_v2(store->hot[EntityHot_X][i], store->hot[EntityHot_Y][i]),
+        .rad = store->hot[EntityHot_Rad][i],
+        .angular_velocity = store->hot[EntityHot_AngularVelocity][i],
+        .velocity = store->hot[EntityHot_Velocity][i],
+        .thrust = store->hot[EntityHot_Thrust][i],
+        .drag = store->hot[EntityHot_Drag][i],
+        .speed = store->hot[EntityHot_Speed][i],
+    };
+    return(result);
+}
 
-        return(e);
+// NOTE: snap also overwrites the previous step, so the change isn't interpolated (spawns, teleports)
+static void
+entity_set_body(PermanentMemory* pm, Entity* e, EntityBody body, bool snap = false){
+    EntityStore* store = &pm->entity_store;
+    u32 i = (u32)(e - store->entities);
+    store->hot[EntityHot_X][i] = body.origin.x;
+    store->hot[EntityHot_Y][i] = body.origin.y;
+    store->hot[EntityHot_Rad][i] = body.rad;
+    store->hot[EntityHot_AngularVelocity][i] = body.angular_velocity;
+    store->hot[EntityHot_Velocity][i] = body.velocity;
+    store->hot[EntityHot_Thrust][i] = body.thrust;
+    store->hot[EntityHot_Drag][i] = body.drag;
+    store->hot[EntityHot_Speed][i] = body.speed;
+    if(snap){
+        store->hot[EntityHot_PrevX][i] = body.origin.x;
+        store->hot[EntityHot_PrevY][i] = body.origin.y;
+        store->hot[EntityHot_PrevRad][i] = body.rad;
     }
-    return(0);
+}
+
+static void
+entity_set_collider(PermanentMemory* pm, Entity* e, Collider collider){
+    EntityStore* store = &pm->entity_store;
+    store->colliders[e - store->entities] = collider;
+}
+
+// NOTE: body blended between the previous and current sim step (alpha 0..1)
+static EntityBody
+entity_body_lerp(PermanentMemory* pm, Entity* e, f32 alpha){
+    EntityStore* store = &pm->entity_store;
+    u32 i = (u32)(e - store->entities);
+    f32* x = store->hot[EntityHot_X];
+    f32* y = store->hot[EntityHot_Y];
+    f32* rad = store->hot[EntityHot_Rad];
+    f32* prev_x = store->hot[EntityHot_PrevX];
+    f32* prev_y = store->hot[EntityHot_PrevY];
+    f32* prev_rad = store->hot[EntityHot_PrevRad];
+    EntityBody result = {
+        .origin = make_v2(prev_x[i] + alpha*(x[i] - prev_x[i]), prev_y[i] + alpha*(y[i] - prev_y[i])),
+        .rad = prev_rad[i] + alpha*(rad[i] - prev_rad[i]),
+        .angular_velocity = store->hot[EntityHot_AngularVelocity][i],
+        .velocity = store->hot[EntityHot_Velocity][i],
+        .thrust = store->hot[EntityHot_Thrust][i],
+        .drag = store->hot[EntityHot_Drag][i],
+        .speed = store->hot[EntityHot_Speed][i],
+    };
+    return(result);
 }
 
 static Entity*
 add_pixel(PermanentMemory* pm, Rect rect, RGBA color){
     Entity* e = add_entity(pm, EntityType_Pixel);
-    e->rect = rect;
-    e->color = color;
+    if(e){
+        e->rect = rect;
+        e->color = color;
+    }
     return(e);
 }
 
 static Entity*
 add_segment(PermanentMemory* pm, v2 p0, v2 p1, RGBA color){
     Entity* e = add_entity(pm, EntityType_Segment);
-    e->color = color;
-    e->p0 = p0;
-    e->p1 = p1;
+    if(e){
+        e->color = color;
+        e->p0 = p0;
+        e->p1 = p1;
+    }
     return(e);
 }
 
 static Entity*
 add_ray(PermanentMemory* pm, Rect rect, v2 direction, RGBA color){
     Entity* e = add_entity(pm, EntityType_Ray);
-    e->rect = rect;
-    e->color = color;
-    e->direction = direction;
+    if(e){
+        e->rect = rect;
+        e->color = color;
+        e->direction = direction;
+    }
     return(e);
 }
 
 static Entity*
 add_line(PermanentMemory* pm, Rect rect, v2 direction, RGBA color){
     Entity* e = add_entity(pm, EntityType_Line);
-    e->rect = rect;
-    e->color = color;
-    e->direction = direction;
+    if(e){
+        e->rect = rect;
+        e->color = color;
+        e->direction = direction;
+    }
     return(e);
 }
 
 static Entity*
 add_rect(PermanentMemory* pm, Rect rect, RGBA color, s32 bsize = 0, RGBA bcolor = {0, 0, 0, 0}){
     Entity* e = add_entity(pm, EntityType_Rect);
-    e->rect =  rect;
-    e->color = color;
-    e->border_size =  bsize;
-    e->border_color = bcolor;
+    if(e){
+        e->rect =  rect;
+        e->color = color;
+        e->border_size =  bsize;
+        e->border_color = bcolor;
+    }
     return(e);
 }
 
 static Entity*
 add_basis(PermanentMemory* pm, v2 origin, v2 x_axis, v2 y_axis, Bitmap texture, RGBA color = {0, 0, 0, 1}){
     Entity* e = add_entity(pm, EntityType_Basis);
-    e->origin = origin;
-    e->x_axis = x_axis;
-    e->y_axis = y_axis;
-    e->color = color;
-    e->texture = texture;
+    if(e){
+        EntityBody body = {.origin = origin};
+        entity_set_body(pm, e, body, true);
+        e->x_axis = x_axis;
+        e->y_axis = y_axis;
+        e->color = color;
+        e->texture = texture;
+    }
     return(e);
 }
 
+// NOTE: colliders are sized off e->scale, so loading a save can rebuild them from the entity
+static Collider
+ship_collider(Entity* e){
+    Collider result = {
+        .radius = e->scale * 0.5f,
+        .layer = CollisionLayer_Ship,
+        .mask = CollisionLayer_Asteroid,
+    };
+    return(result);
+}
+
+static Collider
+asteroid_collider(Entity* e){
+    Collider result = {
+        .radius = e->scale * 0.5f,
+        .layer = CollisionLayer_Asteroid,
+        .mask = CollisionLayer_Ship|CollisionLayer_Bullet,
+    };
+    return(result);
+}
+
+static Collider
+bullet_collider(Entity* e){
+    Collider result = {
+        .radius = e->scale * 0.5f,
+        .layer = CollisionLayer_Bullet,
+        .mask = CollisionLayer_Asteroid,
+    };
+    return(result);
+}
+
 static Entity*
 add_ship(PermanentMemory* pm, v2 origin, v2 x_axis, v2 y_axis, Bitmap texture, RGBA color = {0, 0, 0, 1}){
     Entity* e = add_entity(pm, EntityType_Ship);
-    e->origin = origin;
-    e->x_axis = x_axis;
-    e->y_axis = y_axis;
-    e->color = color;
-    e->texture = texture;
-    e->direction = make_v2(0, 1);
-    e->rad = dir_to_rad(e->direction);
-    e->speed = 250;
-    e->scale = 50;
-    pm->ship_loaded = true; // TODO: get rid of
+    if(e){
+        e->x_axis = x_axis;
+        e->y_axis = y_axis;
+        e->color = color;
+        e->texture = texture;
+        e->scale = SHIP_SCALE;
+        EntityBody body = {
+            .origin = origin,
+            .rad = dir_to_rad(make_v2(0, 1)),
+            .speed = 250,
+        };
+        entity_set_body(pm, e, body, true);
+        entity_set_collider(pm, e, ship_collider(e));
+        pm->ship_loaded = true; // TODO: get rid of
+    }
+    return(e);
+}
+
+// NOTE: drifts in a straight line along direction at full speed, nothing slows it down
+static Entity*
+add_asteroid(PermanentMemory* pm, v2 origin, v2 direction, Bitmap texture){
+    Entity* e = add_entity(pm, EntityType_Asteroid);
+    if(e){
+        e->texture = texture;
+        e->scale = ASTEROID_SCALE;
+        EntityBody body = {
+            .origin = origin,
+            .rad = dir_to_rad(direction),
+            .velocity = 1,
+            .speed = ASTEROID_SPEED,
+        };
+        entity_set_body(pm, e, body, true);
+        entity_set_collider(pm, e, asteroid_collider(e));
+    }
+    return(e);
+}
+
+static Entity*
+add_bullet(PermanentMemory* pm, v2 origin, v2 direction, Bitmap texture){
+    Entity* e = add_entity(pm, EntityType_Bullet);
+    if(e){
+        e->texture = texture;
+        e->scale = BULLET_SCALE;
+        EntityBody body = {
+            .origin = origin,
+            .rad = dir_to_rad(direction),
+            .velocity = 1,
+            .speed = BULLET_SPEED,
+        };
+        entity_set_body(pm, e, body, true);
+        entity_set_collider(pm, e, bullet_collider(e));
+    }
     return(e);
 }
 
 static Entity*
 add_box(PermanentMemory* pm, Rect rect, RGBA color){
     Entity* e = add_entity(pm, EntityType_Box);
-    e->rect = rect;
-    e->color = color;
+    if(e){
+        e->rect = rect;
+        e->color = color;
+    }
     return(e);
 }
 
 static Entity*
 add_quad(PermanentMemory* pm, v2 p0, v2 p1, v2 p2, v2 p3, RGBA color, bool fill){
     Entity* e = add_entity(pm, EntityType_Quad);
-    e->color = color;
-    e->p0 = p0;
-    e->p1 = p1;
-    e->p2 = p2;
-    e->p3 = p3;
-    e->fill = fill;
+    if(e){
+        e->color = color;
+        e->p0 = p0;
+        e->p1 = p1;
+        e->p2 = p2;
+        e->p3 = p3;
+        e->fill = fill;
+    }
     return(e);
 }
 
 static Entity*
 add_triangle(PermanentMemory *pm, v2 p0, v2 p1, v2 p2, RGBA color, bool fill){
     Entity* e = add_entity(pm, EntityType_Triangle);
-    e->p0 = p0;
-    e->p1 = p1;
-    e->p2 = p2;
-    e->color = color;
-    e->fill = fill;
+    if(e){
+        e->p0 = p0;
+        e->p1 = p1;
+        e->p2 = p2;
+        e->color = color;
+        e->fill = fill;
+    }
     return(e);
 }
 
 static Entity*
 add_circle(PermanentMemory *pm, Rect rect, u8 rad, RGBA color, bool fill){
     Entity* e = add_entity(pm, EntityType_Circle);
-    e->rect = rect;
-    e->color = color;
-    e->fill = fill;
-    e->rad = rad;
+    if(e){
+        e->rect = rect;
+        e->color = color;
+        e->fill = fill;
+        e->rad = rad;
+    }
     return(e);
 }
 
 static Entity*
 add_bitmap(PermanentMemory* pm, v2 pos, Bitmap texture){
     Entity* e = add_entity(pm, EntityType_Bitmap);
-    e->rect = make_rect(pos.x, pos.y, 0, 0);
-    e->texture = texture;
+    if(e){
+        e->rect = make_rect(pos.x, pos.y, 0, 0);
+        e->texture = texture;
+    }
     return(e);
 }
 
+// NOTE: keeps committed pages and generations, so handles from before the clear stay stale
 static void
 entities_clear(PermanentMemory* pm){
-    pm->free_entities_at = ENTITIES_MAX - 1;
-    for(u32 i = pm->free_entities_at; i <= pm->free_entities_at; --i){
-        pm->free_entities[i] = pm->free_entities_at - i;
-        pm->generation[i] = 0;
+    EntityStore* store = &pm->entity_store;
+    for(u32 i=0; i < store->count; ++i){
+        entity_store_bump_generation(store, store->entities[i].index);
     }
-    pm->entities_count = 0;
+    store->slots_used = 0;
+    store->free_count = 0;
+    store->count = 0;
 }
 
+// NOTE: save files are a SaveHeader followed by record_count records, each one the Entity and then
+// its EntityBody. Both are written as raw structs, so any change to either layout has to bump
+// SAVE_VERSION, files with a different version or record size are rejected on load.
+#define SAVE_MAGIC 0x44494F52 // "ROID"
+#define SAVE_VERSION 1
+#define SAVE_RECORD_SIZE (sizeof(Entity) + sizeof(EntityBody))
+
+typedef struct SaveHeader{
+    u32 magic;
+    u32 version;
+    u32 record_size;
+    u32 record_count;
+} SaveHeader;
+
 static void
 serialize_data(PermanentMemory* pm, String8 filename){
     os_file_create(pm->saves_dir, filename, 1);
-    u32 offset = 0;
-    for(u32 i=0; i < array_count(pm->entities); ++i){
-        Entity* e = pm->entities + i;
-        if(e->type != EntityType_None){
-            size_t size = sizeof(*e);
-            FileData data = {
-                .base = e,
-                .size = size,
-            };
-            os_file_write(data, pm->saves_dir, filename, offset);
-            offset += size;
-        }
+    SaveHeader header = {
+        .magic = SAVE_MAGIC,
+        .version = SAVE_VERSION,
+        .record_size = (u32)SAVE_RECORD_SIZE,
+        .record_count = pm->entity_store.count,
+    };
+    FileData data = {
+        .base = &header,
+        .size = sizeof(header),
+    };
+    os_file_write(data, pm->saves_dir, filename, 0);
+    u32 offset = (u32)data.size;
+
+    for(u32 i=0; i < pm->entity_store.count; ++i){
+        Entity* e = pm->entity_store.entities + i;
+        EntityBody body = entity_body(pm, e);
+        data.base = e;
+        data.size = sizeof(*e);
+        os_file_write(data, pm->saves_dir, filename, offset);
+        offset += (u32)data.size;
+
+        data.base = &body;
+        data.size = sizeof(body);
+        os_file_write(data, pm->saves_dir, filename, offset);
+        offset += (u32)data.size;
     }
 }
 
-static void
+// NOTE: returns false and leaves the current entities alone if the file can't be read or wasn't
+// written by this version of serialize_data()
+static bool
 deserialize_data(PermanentMemory* pm, String8 filename){
+    ScratchArena scratch = begin_scratch(0);
+    defer(end_scratch(scratch));
+
     FileData data;
-    bool succeed = os_file_read(&pm->arena, &data, pm->saves_dir, filename);
-    if(succeed){
-        entities_clear(pm);
-        u32 offset = 0;
-        while(offset < data.size){
-            Entity* e = (Entity*)((u8*)data.base + offset);
-            switch(e->type){
-                case EntityType_Ship:{
-                    Entity* ship = add_entity(pm, EntityType_Ship);
-                    *ship = *e;
-
-                    String8 ship_str = str8_literal("\\ship_simple.bmp");
-                    Bitmap ship_image = load_bitmap(&tm->arena, pm->sprites_dir, ship_str);
-                    ship->texture = ship_image;
-
-                    pm->ship = ship;
-                    pm->ship_loaded = true;
-                } break;
-                case EntityType_Rect:{
-                    add_rect(pm, e->rect, e->color, e->border_size, e->border_color);
-                } break;
-            }
-            offset += sizeof(*e);
+    if(!os_file_read(scratch.arena, &data, pm->saves_dir, filename)){
+        return(false);
+    }
+    if(data.size < sizeof(SaveHeader)){
+        print("deserialize: %s is too small to be a save\n", filename.str);
+        return(false);
+    }
+    SaveHeader* header = (SaveHeader*)data.base;
+    if(header->magic != SAVE_MAGIC){
+        print("deserialize: %s is not a save\n", filename.str);
+        return(false);
+    }
+    if(header->version != SAVE_VERSION || header->record_size != SAVE_RECORD_SIZE){
+        print("deserialize: %s is save version %u with %u byte records, expected version %u with %u byte records\n",
+              filename.str, header->version, header->record_size, SAVE_VERSION, (u32)SAVE_RECORD_SIZE);
+        return(false);
+    }
+    if(data.size != sizeof(SaveHeader) + (u64)header->record_count * SAVE_RECORD_SIZE){
+        print("deserialize: %s is truncated or has trailing data\n", filename.str);
+        return(false);
+    }
+
+    entities_clear(pm);
+    u8* record = (u8*)data.base + sizeof(SaveHeader);
+    for(u32 i=0; i < header->record_count; ++i){
+        Entity* e = (Entity*)record;
+        EntityBody* body = (EntityBody*)(record + sizeof(Entity));
+        switch(e->type){
+            case EntityType_Ship:{
+                Entity* ship = add_entity(pm, EntityType_Ship);
+                if(!ship){
+                    print("deserialize: out of entity storage\n");
+                    return(true);
+                }
+                // NOTE: the saved slot means nothing here, keep the one we were handed
+                u32 index = ship->index;
+                u32 generation = ship->generation;
+                *ship = *e;
+                ship->index = index;
+                ship->generation = generation;
+                entity_set_body(pm, ship, *body, true);
+                entity_set_collider(pm, ship, ship_collider(ship));
+                ship->texture = pm->ship_texture;
+
+                pm->ship = handle_from_entity(pm, ship);
+                pm->ship_loaded = true;
+            } break;
+            case EntityType_Rect:{
+                add_rect(pm, e->rect, e->color, e->border_size, e->border_color);
+            } break;
+            case EntityType_Asteroid:{
+                Entity* asteroid = add_asteroid(pm, body->origin, make_v2(1, 0), pm->asteroid_texture);
+                if(asteroid){
+                    entity_set_body(pm, asteroid, *body, true);
+                }
+            } break;
+            case EntityType_Bullet:{
+                Entity* bullet = add_bullet(pm, body->origin, make_v2(1, 0), pm->bullet_texture);
+                if(bullet){
+                    entity_set_body(pm, bullet, *body, true);
+                }
+            } break;
         }
+        record += SAVE_RECORD_SIZE;
     }
+    return(true);
 }
 
 #include "console.h"
@@ -379,16 +767,107 @@ handle_controller_events(Event event){
 }
 
 static void
-update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock* clock){
+entities_save_previous(PermanentMemory* pm){
+    EntityStore* store = &pm->entity_store;
+    f32* x = store->hot[EntityHot_X];
+    f32* y = store->hot[EntityHot_Y];
+    f32* rad = store->hot[EntityHot_Rad];
+    f32* prev_x = store->hot[EntityHot_PrevX];
+    f32* prev_y = store->hot[EntityHot_PrevY];
+    f32* prev_rad = store->hot[EntityHot_PrevRad];
+    for(u32 i=0; i < store->count; ++i){
+        prev_x[i] = x[i];
+        prev_y[i] = y[i];
+        prev_rad[i] = rad[i];
+    }
+}
+
+// NOTE: turns, thrusts and moves every entity, wrapping around the playfield
+static void
+entities_integrate(PermanentMemory* pm, f32 dt){
+    EntityStore* store = &pm->entity_store;
+    Bodies bodies = {
+        .x = store->hot[EntityHot_X],
+        .y = store->hot[EntityHot_Y],
+        .prev_x = store->hot[EntityHot_PrevX],
+        .prev_y = store->hot[EntityHot_PrevY],
+        .rad = store->hot[EntityHot_Rad],
+        .prev_rad = store->hot[EntityHot_PrevRad],
+        .angular_velocity = store->hot[EntityHot_AngularVelocity],
+        .velocity = store->hot[EntityHot_Velocity],
+        .thrust = store->hot[EntityHot_Thrust],
+        .drag = store->hot[EntityHot_Drag],
+        .speed = store->hot[EntityHot_Speed],
+    };
+    integrate_bodies(bodies, store->count, dt, pm->playfield);
+}
+
+typedef struct CollisionPairs{
+    CollisionPair* pairs; // NOTE: dense indices, only good until the next remove_entity()
+    u32 count;
+} CollisionPairs;
+
+// NOTE: overlapping collider pairs for this tick, the grid and pairs are allocated out of arena.
+// Hand it scratch (begin_scratch()/end_scratch() around using the pairs), not tm->arena: that one
+// also holds the render command arenas and texture data and gets freed every tick.
+static CollisionPairs
+entities_collide(PermanentMemory* pm, Arena* arena){
+    EntityStore* store = &pm->entity_store;
+    f32* x = store->hot[EntityHot_X];
+    f32* y = store->hot[EntityHot_Y];
+    SpatialGrid grid = spatial_grid_build(arena, x, y, store->colliders, store->count, pm->playfield, COLLISION_CELL_SIZE);
+
+    u32 capacity = store->count * COLLISION_PAIRS_PER_ENTITY;
+    CollisionPair* pairs = push_array(arena, CollisionPair, capacity + 1);
+    u32 count = spatial_grid_overlaps(&grid, pairs, capacity);
+    if(count > capacity){
+        // NOTE: rare pile up, redo it with room for all of them
+        capacity = count;
+        pairs = push_array(arena, CollisionPair, capacity + 1);
+        count = spatial_grid_overlaps(&grid, pairs, capacity);
+    }
+
+    CollisionPairs result = {0};
+    result.pairs = pairs;
+    result.count = count;
+    return(result);
+}
+
+// NOTE: what the broad phase found on the last tick, by the layers involved. Nothing reacts to
+// hits yet, the platform layer only reads these for stats.
+typedef struct CollisionStats{
+    u32 pairs;
+    u32 ship_asteroid;
+    u32 bullet_asteroid;
+} CollisionStats;
+global CollisionStats collision_stats;
+
+static void
+count_collisions(PermanentMemory* pm, CollisionPairs pairs){
+    Collider* colliders = pm->entity_store.colliders;
+    CollisionStats stats = {0};
+    stats.pairs = pairs.count;
+    for(u32 i=0; i < pairs.count; ++i){
+        u32 layers = colliders[pairs.pairs[i].a].layer | colliders[pairs.pairs[i].b].layer;
+        if(layers == (CollisionLayer_Ship|CollisionLayer_Asteroid)){
+            stats.ship_asteroid++;
+        }
+        else if(layers == (CollisionLayer_Bullet|CollisionLayer_Asteroid)){
+            stats.bullet_asteroid++;
+        }
+    }
+    collision_stats = stats;
+}
+
+// NOTE: one fixed simulation step, only updates state. Render commands are built once per
+// displayed frame by render_game().
+static void
+update_game(Memory* memory, Events* events, Clock* clock){
     assert(sizeof(PermanentMemory) < memory->permanent_size);
     assert(sizeof(TransientMemory) < memory->transient_size);
     pm = (PermanentMemory*)memory->permanent_base;
     tm = (TransientMemory*)memory->transient_base;
 
-
-    arena_free(render_buffer->render_command_arena);
-    push_clear_color(render_buffer->render_command_arena, BLACK);
-    Arena* render_command_arena = render_buffer->render_command_arena;
     if(!memory->initialized){
         Button a = controller.up;
 
@@ -398,8 +877,11 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
         tm->render_command_arena = push_arena(&tm->arena, MB(16));
         tm->frame_arena = push_arena(&tm->arena, MB(100));
 
-        // setup free entities array (max to 0)
-        entities_clear(pm);
+        if(!entity_store_init(&pm->entity_store, memory)){
+            print("failed to reserve entity storage\n");
+        }
+        // NOTE: a margin past the screen so sprites are fully off before they come around
+        pm->playfield = make_rect(-PLAYFIELD_MARGIN, -PLAYFIELD_MARGIN, (f32)resolution.x + PLAYFIELD_MARGIN, (f32)resolution.y + PLAYFIELD_MARGIN);
 
         pm->cwd = os_get_cwd(&pm->arena);
         pm->data_dir    = str8_path_append(&pm->arena, pm->cwd,      str8_literal("data"));
@@ -414,10 +896,13 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
         String8 circle_str = str8_literal("circle.bmp");
         String8 ship_str   = str8_literal("ship_simple.bmp");
 
-        Bitmap image_image = load_bitmap(&tm->arena, pm->sprites_dir, image_str);
-        Bitmap ship_image = load_bitmap(&tm->arena, pm->sprites_dir, ship_str);
-        Bitmap tree_image = load_bitmap(&pm->arena, pm->sprites_dir, tree_str);
-        Bitmap circle_image = load_bitmap(&tm->arena, pm->sprites_dir, circle_str);
+        Bitmap image_image = load_bitmap(&pm->arena, pm->sprites_dir, image_str, BitmapFormat_Linear16);
+        Bitmap ship_image = load_bitmap(&pm->arena, pm->sprites_dir, ship_str, BitmapFormat_Linear16);
+        Bitmap tree_image = load_bitmap(&pm->arena, pm->sprites_dir, tree_str, BitmapFormat_Linear16);
+        Bitmap circle_image = load_bitmap(&pm->arena, pm->sprites_dir, circle_str, BitmapFormat_Linear16);
+        pm->ship_texture = ship_image;
+        pm->asteroid_texture = circle_image;
+        pm->bullet_texture = circle_image;
 
         //Bitmap ship_image = load_bitmap(&pm->arena, pm->sprites_dir, ship_str);
         //Bitmap aa = stb_load_image(pm->sprites_dir, circle_str);
@@ -440,6 +925,14 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
         //add_rect(pm, rect_screen_to_pixel(make_rect(.5, .5f, .6, .6), resolution), MAGENTA, 0, BLUE);
         //add_rect(pm, rect_screen_to_pixel(make_rect(.7, .5f, .8, .6), resolution), MAGENTA, -20000, TEAL);
 
+        // NOTE: asteroids spread along the top and bottom edges, heading diagonally across the screen
+        for(u32 i=0; i < ASTEROID_SPAWN_COUNT; ++i){
+            bool top = (i & 1);
+            v2 spawn = make_v2(((f32)i + 0.5f) * (f32)resolution.x / ASTEROID_SPAWN_COUNT, top ? (f32)resolution.y : 0.0f);
+            v2 heading = make_v2((i & 2) ? 1.0f : -1.0f, top ? -1.0f : 1.0f);
+            add_asteroid(pm, spawn, heading, circle_image);
+        }
+
         //Inconsolata-Regular
         Bitmap inconsolate[128];
 
@@ -464,6 +957,7 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
         memory->initialized = true;
     }
 
+    entities_save_previous(pm);
 
     // NOTE: process events.
     while(!events_empty(events)){
@@ -481,35 +975,67 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
         }
     }
 
-    if(pm->ship_loaded){
-        Entity* ship = pm->ship;
+    Entity* ship = entity_from_handle(pm, pm->ship);
+    if(pm->ship_loaded && ship){
+        // NOTE: controls only steer, entities_integrate() does the moving
+        EntityBody body = entity_body(pm, ship);
         // rotate ship
+        body.angular_velocity = 0;
         if(controller.right.held){
-            ship->rad -= 2 * (f32)clock->dt;
+            body.angular_velocity -= 2;
         }
         if(controller.left.held){
-            ship->rad += 2 * (f32)clock->dt;
+            body.angular_velocity += 2;
         }
 
         // increase ship velocity
+        body.thrust = 0;
         if(controller.up.held){
-            ship->velocity += (f32)clock->dt;
+            body.thrust += 1;
         }
         if(controller.down.held){
-            ship->velocity -= (f32)clock->dt;
+            body.thrust -= 1;
         }
-        clamp_f32(0, 1, &ship->velocity);
-
-        // move ship
-        ship->direction = rad_to_dir(ship->rad);
-        ship->origin.x += (ship->direction.x * ship->velocity * ship->speed) * (f32)clock->dt;
-        ship->origin.y += (ship->direction.y * ship->velocity * ship->speed) * (f32)clock->dt;
-        //print("x: %f - y: %f - v: %f - a: %f\n", ship->direction.x, ship->direction.y, ship->velocity, ship->rad);
+        entity_set_body(pm, ship, body);
+        //print("x: %f - y: %f - v: %f - a: %f\n", body.origin.x, body.origin.y, body.velocity, body.rad);
     }
 
+    // move everything
+    entities_integrate(pm, (f32)clock->dt);
+
+    // collide
+    ScratchArena scratch = begin_scratch(0);
+    CollisionPairs pairs = entities_collide(pm, scratch.arena);
+    count_collisions(pm, pairs);
+    end_scratch(scratch);
+
     update_console();
-    for(u32 entity_index = (u32)pm->free_entities_at; entity_index < array_count(pm->entities); ++entity_index){
-        Entity *e = pm->entities + pm->free_entities[entity_index];
+
+    clear_controller_pressed(&controller);
+    arena_free(&tm->arena);
+}
+
+// NOTE: alpha is how far we are between the previous and the current sim step (0..1)
+static void
+render_game(Memory* memory, RenderBuffer* render_buffer, f32 alpha){
+    pm = (PermanentMemory*)memory->permanent_base;
+    tm = (TransientMemory*)memory->transient_base;
+
+    Arena* render_command_arena = render_buffer->render_command_arena;
+    arena_free(render_command_arena);
+    render_cull_begin(make_rect(0, 0, (f32)render_buffer->width, (f32)render_buffer->height));
+    push_clear_color(render_command_arena, BLACK);
+    if(!memory->initialized){
+        return;
+    }
+
+    s32 z = 0;
+    for(u32 entity_index=0; entity_index < pm->entity_store.count; ++entity_index){
+        Entity *e = pm->entity_store.entities + entity_index;
+        if(e->z != z){
+            z = e->z;
+            push_layer(render_command_arena, z);
+        }
 
         switch(e->type){
             case EntityType_Glyph:{
@@ -536,30 +1062,43 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
                     border = e->rect;
                     rect = rect_calc_border(e->rect, e->border_size);
                 }
-                push_rect(render_command_arena, border, e->border_color);
+                if(e->border_size != 0){
+                    push_rect(render_command_arena, border, e->border_color);
+                }
                 push_rect(render_command_arena, rect, e->color);
             }break;
             case EntityType_Ship:{
-                f32 deg = rad_to_deg(e->rad);
+                EntityBody body = entity_body_lerp(pm, e, alpha);
+                v2 origin = body.origin;
+                f32 deg = rad_to_deg(body.rad);
                 deg -= 90;
                 f32 rad = deg_to_rad(deg);
-                e->x_axis = e->scale * make_v2(cos_f32(rad), sin_f32(rad));
-                e->y_axis = perp(e->x_axis);
-                v2 center_org = e->origin - 0.5*e->x_axis - 0.5*e->y_axis;
+                v2 x_axis = e->scale * make_v2(cos_f32(rad), sin_f32(rad));
+                v2 y_axis = perp(x_axis);
+                v2 center_org = origin - 0.5*x_axis - 0.5*y_axis;
 
-                push_basis(render_command_arena, center_org, e->x_axis, e->y_axis, e->texture);
+                push_basis(render_command_arena, center_org, x_axis, y_axis, &e->texture);
+            }break;
+            case EntityType_Asteroid:
+            case EntityType_Bullet:{
+                EntityBody body = entity_body_lerp(pm, e, alpha);
+                v2 x_axis = e->scale * make_v2(cos_f32(body.rad), sin_f32(body.rad));
+                v2 y_axis = perp(x_axis);
+                push_basis(render_command_arena, body.origin - 0.5*x_axis - 0.5*y_axis, x_axis, y_axis, &e->texture);
             }break;
             case EntityType_Basis:{
 				v2 dim = {5, 5};
-				v2 min = e->origin;
+                EntityBody body = entity_body_lerp(pm, e, alpha);
+				v2 min = body.origin;
                 //RGBA color = {1, 1, 0, 1};
                 //f32 disp = 50.0f * cos_f32(angle);
                 //e->origin = make_v2((f32)resolution.x/2, (f32)resolution.y/2);
-                f32 deg = rad_to_deg(e->rad);
+                v2 origin = body.origin;
+                f32 deg = rad_to_deg(body.rad);
                 deg -= 90;
                 f32 rad = deg_to_rad(deg);
-                e->x_axis = e->scale * make_v2(cos_f32(rad), sin_f32(rad));
-                e->y_axis = perp(e->x_axis);
+                v2 x_axis = e->scale * make_v2(cos_f32(rad), sin_f32(rad));
+                v2 y_axis = perp(x_axis);
                 //
                 //e->x_axis = (50.0f + 50.0f * cos_f32(angle*2)) * make_v2(cos_f32(angle*2), sin_f32(angle*2));
                 //e->y_axis = (50.0f + 50.0f * cos_f32(angle*2)) * make_v2(cos_f32((angle*2) + 1.0f), sin_f32((angle*2) + 1.0f));
@@ -569,17 +1108,17 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
                 //e->y_axis = make_v2(-e->x_axis.y, e->x_axis.x);
                 //e->y_axis = {0, 400};
 
-                push_basis(render_command_arena, e->origin - 0.5*e->x_axis - 0.5*e->y_axis, e->x_axis, e->y_axis, e->texture);
+                push_basis(render_command_arena, origin - 0.5*x_axis - 0.5*y_axis, x_axis, y_axis, &e->texture);
 
                 //push_rect(render_command_arena, make_rect(min - dim, min + dim), color);
 
-				min = e->origin + e->x_axis;
+				min = origin + e->x_axis;
                 //push_rect(render_command_arena, make_rect(min - dim, min + dim), color);
 
-				min = e->origin + e->y_axis;
+				min = origin + e->y_axis;
                 //push_rect(render_command_arena, make_rect(min - dim, min + dim), color);
 
-                v2 max = e->origin + e->x_axis + e->y_axis;
+                v2 max = origin + e->x_axis + e->y_axis;
                 //push_rect(render_command_arena, make_rect(max - dim, max + dim), color);
 
             }break;
@@ -596,7 +1135,7 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
                 push_circle(render_command_arena, e->rect, e->rad, e->color, e->fill);
             }break;
             case EntityType_Bitmap:{
-                push_bitmap(render_command_arena, e->rect, e->texture);
+                push_bitmap(render_command_arena, e->rect.min, &e->texture);
             }break;
             case EntityType_None:{
             }break;
@@ -607,6 +1146,7 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
     }
 
     if(console_is_visible()){
+        push_layer(render_command_arena, RENDER_LAYER_TOP);
         push_console(render_command_arena);
     }
     String8 text = str8_literal("get! This is my program.\nIt renders fonts.\nHere is some dummy text 123.\nMore Dummy Text ONETWOTHREE\nEND OF DUMMY_TEXT_TEST.H OK");
@@ -641,15 +1181,11 @@ update_game(Memory* memory, RenderBuffer* render_buffer, Events* events, Clock*
     //draw_pixel(render_buffer, make_v2(1, 1), RED);
     //draw_pixel(render_buffer, make_v2(0, 0), RED);
     //push_rect(render_command_arena, make_rect(20, 20, render_buffer->width + 10, render_buffer->height + 10), RED);
-    //push_rect(render_command_arena, Rect rect, RGBA color, s32 border_size = 0, RGBA border_color = {0, 0, 0, 0}){
     //draw_rect_slow(render_buffer, make_v2(50, 50), make_v2(100, 0), make_v2(0, 100), GREEN);
     //draw_rect_slow2(render_buffer, make_v2(50, 50), make_v2(100, 0), make_v2(0, 100), YELLOW);
     String8 s = str8_literal("Rafik hahahah LOLOLOLOL");
     //draw_string(render_buffer, make_v2(500, 300), s, 0xF8DB5E);
     //draw_bitmap(render_buffer, make_v2(100, 100), &pm->tree);
-
-    clear_controller_pressed(&controller);
-    arena_free(&tm->arena);
 }
 
 #endif
@@ -0,0 +1,268 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+// NOTE: Batch integration for everything that flies around (ships, asteroids, debris). Bodies
+// points at SoA arrays with one entry per body, integrate_bodies() advances all of them one step:
+//     rad      += angular_velocity * dt             (kept in -pi..pi)
+//     velocity += thrust * dt - velocity * drag * dt (clamped to 0..1, it's a fraction of speed)
+//     origin   += (cos rad, sin rad) * velocity * speed * dt
+// and then wraps origin around the playfield. prev_* gets shifted by the same amount as the wrap,
+// so render interpolation doesn't streak across the screen or spin the long way round.
+// sin/cos is a polynomial approximation done 8 (AVX2) or 4 (SSE2) bodies at a time.
+typedef struct Bodies{
+    f32* x;
+    f32* y;
+    f32* prev_x;
+    f32* prev_y;
+    f32* rad;
+    f32* prev_rad;
+    f32* angular_velocity;
+    f32* velocity;
+    f32* thrust;
+    f32* drag;
+    f32* speed;
+} Bodies;
+
+#define BODY_TAU 6.28318530718f
+#define BODY_ONE_OVER_TAU 0.159154943092f
+
+// NOTE: q = nearest multiple of pi/2, r = rad - q*pi/2 in -pi/4..pi/4 with pi/2 split in three
+// (Cody-Waite) so the reduction doesn't lose bits, then minimax polynomials for sin/cos of r.
+// Good to ~1e-7 over -pi..pi, which is all integrate_bodies() ever feeds it.
+#define SINCOS_TWO_OVER_PI 0.636619772368f
+#define SINCOS_PI_2_HI  1.5703125f
+#define SINCOS_PI_2_MID 4.837512969970703125e-4f
+#define SINCOS_PI_2_LO  7.54978995489188216e-8f
+#define SINCOS_S1 -1.6666654611e-1f
+#define SINCOS_S2  8.3321608736e-3f
+#define SINCOS_S3 -1.9515295891e-4f
+#define SINCOS_C1  4.166664568298827e-2f
+#define SINCOS_C2 -1.388731625493765e-3f
+#define SINCOS_C3  2.443315711809948e-5f
+
+static s32
+round_f32_to_s32(f32 value){
+    s32 result = (s32)(value + (value >= 0 ? 0.5f : -0.5f));
+    return(result);
+}
+
+static void
+sincos_approx(f32 rad, f32* sin_out, f32* cos_out){
+    s32 q = round_f32_to_s32(rad * SINCOS_TWO_OVER_PI);
+    f32 qf = (f32)q;
+    f32 r = ((rad - qf*SINCOS_PI_2_HI) - qf*SINCOS_PI_2_MID) - qf*SINCOS_PI_2_LO;
+    f32 r2 = r*r;
+    f32 s = r + r*r2*(SINCOS_S1 + r2*(SINCOS_S2 + r2*SINCOS_S3));
+    f32 c = (1.0f - 0.5f*r2) + r2*r2*(SINCOS_C1 + r2*(SINCOS_C2 + r2*SINCOS_C3));
+
+    // NOTE: quadrant q&3 picks sin(r) or cos(r) and their signs
+    if(q & 1){
+        f32 swap = s;
+        s = c;
+        c = swap;
+    }
+    if(q & 2){
+        s = -s;
+    }
+    if((q + 1) & 2){
+        c = -c;
+    }
+    *sin_out = s;
+    *cos_out = c;
+}
+
+static inline void
+sincos_4x(__m128 rad, __m128* sin_out, __m128* cos_out){
+    __m128i one_4x = _mm_set1_epi32(1);
+    __m128i two_4x = _mm_set1_epi32(2);
+
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(rad, _mm_set1_ps(SINCOS_TWO_OVER_PI)));
+    __m128 qf = _mm_cvtepi32_ps(q);
+    __m128 r = _mm_sub_ps(rad, _mm_mul_ps(qf, _mm_set1_ps(SINCOS_PI_2_HI)));
+    r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(SINCOS_PI_2_MID)));
+    r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(SINCOS_PI_2_LO)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 s = _mm_add_ps(_mm_set1_ps(SINCOS_S2), _mm_mul_ps(r2, _mm_set1_ps(SINCOS_S3)));
+    s = _mm_add_ps(_mm_set1_ps(SINCOS_S1), _mm_mul_ps(r2, s));
+    s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+
+    __m128 c = _mm_add_ps(_mm_set1_ps(SINCOS_C2), _mm_mul_ps(r2, _mm_set1_ps(SINCOS_C3)));
+    c = _mm_add_ps(_mm_set1_ps(SINCOS_C1), _mm_mul_ps(r2, c));
+    c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), c));
+
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one_4x), one_4x));
+    __m128 sin_r = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    __m128 cos_r = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    // NOTE: bit 1 of the quadrant shifted up into the sign bit
+    __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two_4x), 30));
+    __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one_4x), two_4x), 30));
+    *sin_out = _mm_xor_ps(sin_r, sin_sign);
+    *cos_out = _mm_xor_ps(cos_r, cos_sign);
+}
+
+TARGET_AVX2 static inline void
+sincos_8x(__m256 rad, __m256* sin_out, __m256* cos_out){
+    __m256i one_8x = _mm256_set1_epi32(1);
+    __m256i two_8x = _mm256_set1_epi32(2);
+
+    __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(rad, _mm256_set1_ps(SINCOS_TWO_OVER_PI)));
+    __m256 qf = _mm256_cvtepi32_ps(q);
+    __m256 r = _mm256_sub_ps(rad, _mm256_mul_ps(qf, _mm256_set1_ps(SINCOS_PI_2_HI)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(SINCOS_PI_2_MID)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(SINCOS_PI_2_LO)));
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 s = _mm256_add_ps(_mm256_set1_ps(SINCOS_S2), _mm256_mul_ps(r2, _mm256_set1_ps(SINCOS_S3)));
+    s = _mm256_add_ps(_mm256_set1_ps(SINCOS_S1), _mm256_mul_ps(r2, s));
+    s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), s));
+
+    __m256 c = _mm256_add_ps(_mm256_set1_ps(SINCOS_C2), _mm256_mul_ps(r2, _mm256_set1_ps(SINCOS_C3)));
+    c = _mm256_add_ps(_mm256_set1_ps(SINCOS_C1), _mm256_mul_ps(r2, c));
+    c = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)), _mm256_mul_ps(_mm256_mul_ps(r2, r2), c));
+
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one_8x), one_8x));
+    __m256 sin_r = _mm256_blendv_ps(s, c, swap);
+    __m256 cos_r = _mm256_blendv_ps(c, s, swap);
+    __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, two_8x), 30));
+    __m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, one_8x), two_8x), 30));
+    *sin_out = _mm256_xor_ps(sin_r, sin_sign);
+    *cos_out = _mm256_xor_ps(cos_r, cos_sign);
+}
+
+// NOTE: bodies in [start, end), one at a time. Handles the tail the wide paths leave over.
+static void
+integrate_bodies_1x(Bodies bodies, u32 start, u32 end, f32 dt, Rect wrap){
+    f32 wrap_width = wrap.x1 - wrap.x0;
+    f32 wrap_height = wrap.y1 - wrap.y0;
+    for(u32 i=start; i < end; ++i){
+        f32 rad = bodies.rad[i] + bodies.angular_velocity[i]*dt;
+        f32 turns = (f32)round_f32_to_s32(rad * BODY_ONE_OVER_TAU) * BODY_TAU;
+        bodies.rad[i] = rad - turns;
+        bodies.prev_rad[i] -= turns;
+
+        f32 velocity = bodies.velocity[i] + bodies.thrust[i]*dt;
+        velocity = velocity - velocity*bodies.drag[i]*dt;
+        velocity = velocity < 0.0f ? 0.0f : velocity;
+        velocity = velocity > 1.0f ? 1.0f : velocity;
+        bodies.velocity[i] = velocity;
+
+        f32 sin_rad, cos_rad;
+        sincos_approx(bodies.rad[i], &sin_rad, &cos_rad);
+        f32 step = velocity * bodies.speed[i] * dt;
+        f32 x = bodies.x[i] + cos_rad*step;
+        f32 y = bodies.y[i] + sin_rad*step;
+
+        // NOTE: an empty wrap rect has zero width/height, so nothing moves
+        f32 shift_x = (x < wrap.x0 ? wrap_width : 0.0f) - (x >= wrap.x1 ? wrap_width : 0.0f);
+        f32 shift_y = (y < wrap.y0 ? wrap_height : 0.0f) - (y >= wrap.y1 ? wrap_height : 0.0f);
+        bodies.x[i] = x + shift_x;
+        bodies.y[i] = y + shift_y;
+        bodies.prev_x[i] += shift_x;
+        bodies.prev_y[i] += shift_y;
+    }
+}
+
+static void
+integrate_bodies_4x(Bodies bodies, u32 start, u32 end, f32 dt, Rect wrap){
+    __m128 dt_4x = _mm_set1_ps(dt);
+    __m128 zero_4x = _mm_set1_ps(0.0f);
+    __m128 one_4x = _mm_set1_ps(1.0f);
+    __m128 tau_4x = _mm_set1_ps(BODY_TAU);
+    __m128 one_over_tau_4x = _mm_set1_ps(BODY_ONE_OVER_TAU);
+    __m128 wrap_x0_4x = _mm_set1_ps(wrap.x0);
+    __m128 wrap_y0_4x = _mm_set1_ps(wrap.y0);
+    __m128 wrap_x1_4x = _mm_set1_ps(wrap.x1);
+    __m128 wrap_y1_4x = _mm_set1_ps(wrap.y1);
+    __m128 wrap_width_4x = _mm_set1_ps(wrap.x1 - wrap.x0);
+    __m128 wrap_height_4x = _mm_set1_ps(wrap.y1 - wrap.y0);
+
+    for(u32 i=start; i < end; i += 4){
+        __m128 rad = _mm_add_ps(_mm_loadu_ps(bodies.rad + i), _mm_mul_ps(_mm_loadu_ps(bodies.angular_velocity + i), dt_4x));
+        __m128 turns = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(rad, one_over_tau_4x))), tau_4x);
+        rad = _mm_sub_ps(rad, turns);
+        _mm_storeu_ps(bodies.rad + i, rad);
+        _mm_storeu_ps(bodies.prev_rad + i, _mm_sub_ps(_mm_loadu_ps(bodies.prev_rad + i), turns));
+
+        __m128 velocity = _mm_add_ps(_mm_loadu_ps(bodies.velocity + i), _mm_mul_ps(_mm_loadu_ps(bodies.thrust + i), dt_4x));
+        velocity = _mm_sub_ps(velocity, _mm_mul_ps(_mm_mul_ps(velocity, _mm_loadu_ps(bodies.drag + i)), dt_4x));
+        velocity = _mm_min_ps(_mm_max_ps(velocity, zero_4x), one_4x);
+        _mm_storeu_ps(bodies.velocity + i, velocity);
+
+        __m128 sin_rad, cos_rad;
+        sincos_4x(rad, &sin_rad, &cos_rad);
+        __m128 step = _mm_mul_ps(_mm_mul_ps(velocity, _mm_loadu_ps(bodies.speed + i)), dt_4x);
+        __m128 x = _mm_add_ps(_mm_loadu_ps(bodies.x + i), _mm_mul_ps(cos_rad, step));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(bodies.y + i), _mm_mul_ps(sin_rad, step));
+
+        __m128 shift_x = _mm_sub_ps(_mm_and_ps(_mm_cmplt_ps(x, wrap_x0_4x), wrap_width_4x),
+                                    _mm_and_ps(_mm_cmpge_ps(x, wrap_x1_4x), wrap_width_4x));
+        __m128 shift_y = _mm_sub_ps(_mm_and_ps(_mm_cmplt_ps(y, wrap_y0_4x), wrap_height_4x),
+                                    _mm_and_ps(_mm_cmpge_ps(y, wrap_y1_4x), wrap_height_4x));
+        _mm_storeu_ps(bodies.x + i, _mm_add_ps(x, shift_x));
+        _mm_storeu_ps(bodies.y + i, _mm_add_ps(y, shift_y));
+        _mm_storeu_ps(bodies.prev_x + i, _mm_add_ps(_mm_loadu_ps(bodies.prev_x + i), shift_x));
+        _mm_storeu_ps(bodies.prev_y + i, _mm_add_ps(_mm_loadu_ps(bodies.prev_y + i), shift_y));
+    }
+}
+
+TARGET_AVX2 static void
+integrate_bodies_8x(Bodies bodies, u32 start, u32 end, f32 dt, Rect wrap){
+    __m256 dt_8x = _mm256_set1_ps(dt);
+    __m256 zero_8x = _mm256_set1_ps(0.0f);
+    __m256 one_8x = _mm256_set1_ps(1.0f);
+    __m256 tau_8x = _mm256_set1_ps(BODY_TAU);
+    __m256 one_over_tau_8x = _mm256_set1_ps(BODY_ONE_OVER_TAU);
+    __m256 wrap_x0_8x = _mm256_set1_ps(wrap.x0);
+    __m256 wrap_y0_8x = _mm256_set1_ps(wrap.y0);
+    __m256 wrap_x1_8x = _mm256_set1_ps(wrap.x1);
+    __m256 wrap_y1_8x = _mm256_set1_ps(wrap.y1);
+    __m256 wrap_width_8x = _mm256_set1_ps(wrap.x1 - wrap.x0);
+    __m256 wrap_height_8x = _mm256_set1_ps(wrap.y1 - wrap.y0);
+
+    for(u32 i=start; i < end; i += 8){
+        __m256 rad = _mm256_add_ps(_mm256_loadu_ps(bodies.rad + i), _mm256_mul_ps(_mm256_loadu_ps(bodies.angular_velocity + i), dt_8x));
+        __m256 turns = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtps_epi32(_mm256_mul_ps(rad, one_over_tau_8x))), tau_8x);
+        rad = _mm256_sub_ps(rad, turns);
+        _mm256_storeu_ps(bodies.rad + i, rad);
+        _mm256_storeu_ps(bodies.prev_rad + i, _mm256_sub_ps(_mm256_loadu_ps(bodies.prev_rad + i), turns));
+
+        __m256 velocity = _mm256_add_ps(_mm256_loadu_ps(bodies.velocity + i), _mm256_mul_ps(_mm256_loadu_ps(bodies.thrust + i), dt_8x));
+        velocity = _mm256_sub_ps(velocity, _mm256_mul_ps(_mm256_mul_ps(velocity, _mm256_loadu_ps(bodies.drag + i)), dt_8x));
+        velocity = _mm256_min_ps(_mm256_max_ps(velocity, zero_8x), one_8x);
+        _mm256_storeu_ps(bodies.velocity + i, velocity);
+
+        __m256 sin_rad, cos_rad;
+        sincos_8x(rad, &sin_rad, &cos_rad);
+        __m256 step = _mm256_mul_ps(_mm256_mul_ps(velocity, _mm256_loadu_ps(bodies.speed + i)), dt_8x);
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(bodies.x + i), _mm256_mul_ps(cos_rad, step));
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(bodies.y + i), _mm256_mul_ps(sin_rad, step));
+
+        __m256 shift_x = _mm256_sub_ps(_mm256_and_ps(_mm256_cmp_ps(x, wrap_x0_8x, _CMP_LT_OQ), wrap_width_8x),
+                                       _mm256_and_ps(_mm256_cmp_ps(x, wrap_x1_8x, _CMP_GE_OQ), wrap_width_8x));
+        __m256 shift_y = _mm256_sub_ps(_mm256_and_ps(_mm256_cmp_ps(y, wrap_y0_8x, _CMP_LT_OQ), wrap_height_8x),
+                                       _mm256_and_ps(_mm256_cmp_ps(y, wrap_y1_8x, _CMP_GE_OQ), wrap_height_8x));
+        _mm256_storeu_ps(bodies.x + i, _mm256_add_ps(x, shift_x));
+        _mm256_storeu_ps(bodies.y + i, _mm256_add_ps(y, shift_y));
+        _mm256_storeu_ps(bodies.prev_x + i, _mm256_add_ps(_mm256_loadu_ps(bodies.prev_x + i), shift_x));
+        _mm256_storeu_ps(bodies.prev_y + i, _mm256_add_ps(_mm256_loadu_ps(bodies.prev_y + i), shift_y));
+    }
+}
+
+// NOTE: pass an empty wrap rect to let bodies fly off forever
+static void
+integrate_bodies(Bodies bodies, u32 count, f32 dt, Rect wrap){
+    assert(cpu_features.detected);
+    u32 batched = 0;
+    if(cpu_features.avx2){
+        batched = count & ~7u;
+        integrate_bodies_8x(bodies, 0, batched, dt, wrap);
+    }
+    else if(cpu_features.sse2){
+        batched = count & ~3u;
+        integrate_bodies_4x(bodies, 0, batched, dt, wrap);
+    }
+    integrate_bodies_1x(bodies, batched, count, dt, wrap);
+}
+
+#endif
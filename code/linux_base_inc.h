@@ -0,0 +1,341 @@
+#ifndef LINUX_BASE_INC_H
+#define LINUX_BASE_INC_H
+
+// NOTE: The slice of the base layer the game needs, for the headless Linux build. main.cpp pulls
+// the full layer in from base_inc.h, this keeps linux_main.cpp buildable with just the code
+// directory: types, arenas, String8 and the v2/RGBA math. Names and signatures match base_inc.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+// --------------------------
+// types
+// --------------------------
+
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef float    f32;
+typedef double   f64;
+typedef s32      b32;
+typedef wchar_t  wchar;
+
+#define global static
+
+#define KB(x) ((size_t)(x) << 10)
+#define MB(x) ((size_t)(x) << 20)
+#define GB(x) ((size_t)(x) << 30)
+
+#define array_count(a) (sizeof(a) / sizeof((a)[0]))
+#define invalid_default_case default: { assert(0); } break
+
+#define print printf
+#define mem_copy(dst, src, size) memcpy((dst), (src), (size))
+
+// NOTE: runs code when the enclosing scope exits
+template <typename F>
+struct Defer{
+    F f;
+    ~Defer(){ f(); }
+};
+template <typename F>
+static Defer<F>
+make_defer(F f){
+    Defer<F> result = {f};
+    return(result);
+}
+#define defer_join_(a, b) a##b
+#define defer_join(a, b) defer_join_(a, b)
+#define defer(code) auto defer_join(defer_, __COUNTER__) = make_defer([&](){ code; })
+
+// --------------------------
+// math
+// --------------------------
+
+#define PI_f32 3.14159265359f
+#define TAU_f32 6.28318530718f
+
+typedef union v2{
+    struct{ f32 x, y; };
+    struct{ f32 w, h; };
+    f32 e[2];
+} v2;
+
+typedef union v2s32{
+    struct{ s32 x, y; };
+    struct{ s32 w, h; };
+    s32 e[2];
+} v2s32;
+
+typedef union v3{
+    struct{ f32 x, y, z; };
+    struct{ f32 r, g, b; };
+    f32 e[3];
+} v3;
+
+typedef union v4{
+    struct{ f32 x, y, z, w; };
+    struct{ f32 r, g, b, a; };
+    struct{ v3 rgb; f32 _a; };
+    f32 e[4];
+} v4;
+typedef v4 RGBA;
+
+static v2
+make_v2(f32 x, f32 y){
+    v2 result = {x, y};
+    return(result);
+}
+
+static v2 operator+(v2 a, v2 b){ return(make_v2(a.x + b.x, a.y + b.y)); }
+static v2 operator-(v2 a, v2 b){ return(make_v2(a.x - b.x, a.y - b.y)); }
+static v2 operator-(v2 a){ return(make_v2(-a.x, -a.y)); }
+static v2 operator*(f32 s, v2 a){ return(make_v2(s * a.x, s * a.y)); }
+static v2 operator*(v2 a, f32 s){ return(make_v2(s * a.x, s * a.y)); }
+static v2 operator*(f64 s, v2 a){ return(make_v2((f32)s * a.x, (f32)s * a.y)); }
+static v2& operator+=(v2& a, v2 b){ a = a + b; return(a); }
+static v2& operator-=(v2& a, v2 b){ a = a - b; return(a); }
+
+static v3& operator*=(v3& a, f32 s){ a.x *= s; a.y *= s; a.z *= s; return(a); }
+
+static RGBA operator*(f32 s, RGBA c){ RGBA result = {s * c.r, s * c.g, s * c.b, s * c.a}; return(result); }
+static RGBA operator+(RGBA a, RGBA b){ RGBA result = {a.r + b.r, a.g + b.g, a.b + b.b, a.a + b.a}; return(result); }
+
+static f32 abs_f32(f32 value){ return(fabsf(value)); }
+static f32 sqrt_f32(f32 value){ return(sqrtf(value)); }
+static f32 square_f32(f32 value){ return(value * value); }
+static f32 ceil_f32(f32 value){ return(ceilf(value)); }
+static f32 floor_f32(f32 value){ return(floorf(value)); }
+static f32 sin_f32(f32 value){ return(sinf(value)); }
+static f32 cos_f32(f32 value){ return(cosf(value)); }
+static f32 atan2_f32(f32 y, f32 x){ return(atan2f(y, x)); }
+static s32 round_f32_s32(f32 value){ return((s32)lroundf(value)); }
+static u32 round_f32_u32(f32 value){ return((u32)lroundf(value)); }
+
+static v2s32
+round_v2_v2s32(v2 value){
+    v2s32 result = {round_f32_s32(value.x), round_f32_s32(value.y)};
+    return(result);
+}
+
+static void
+clamp_f32(f32 lo, f32 hi, f32* value){
+    if(*value < lo){ *value = lo; }
+    if(*value > hi){ *value = hi; }
+}
+
+static f32 lerp(f32 a, f32 b, f32 t){ return(a + (b - a) * t); }
+static RGBA lerp(RGBA a, RGBA b, f32 t){ return((1.0f - t) * a + t * b); }
+
+static f32 dot_v2(v2 a, v2 b){ return(a.x * b.x + a.y * b.y); }
+static f32 magnitude_sqrt_v2(v2 a){ return(dot_v2(a, a)); }
+static f32 magnitude_v2(v2 a){ return(sqrt_f32(dot_v2(a, a))); }
+static v2 perp(v2 a){ return(make_v2(-a.y, a.x)); }
+
+static v2 rad_to_dir(f32 rad){ return(make_v2(cos_f32(rad), sin_f32(rad))); }
+static f32 dir_to_rad(v2 dir){ return(atan2_f32(dir.y, dir.x)); }
+static f32 rad_to_deg(f32 rad){ return(rad * (180.0f / PI_f32)); }
+static f32 deg_to_rad(f32 deg){ return(deg * (PI_f32 / 180.0f)); }
+
+// --------------------------
+// arena
+// --------------------------
+
+typedef struct Arena{
+    void* base;
+    size_t size;
+    size_t used;
+} Arena;
+
+typedef struct ScratchArena{
+    Arena* arena;
+    size_t used;
+} ScratchArena;
+
+static void
+init_arena(Arena* arena, void* base, size_t size){
+    arena->base = base;
+    arena->size = size;
+    arena->used = 0;
+}
+
+static void*
+push_size(Arena* arena, size_t size){
+    assert(arena->used + size <= arena->size);
+    void* result = (u8*)arena->base + arena->used;
+    arena->used += size;
+    return(result);
+}
+#define push_array(arena, type, count) ((type*)push_size((arena), sizeof(type) * (count)))
+
+static void
+arena_free(Arena* arena){
+    arena->used = 0;
+}
+
+static Arena*
+make_arena(size_t size){
+    Arena* result = (Arena*)malloc(sizeof(Arena) + size);
+    init_arena(result, result + 1, size);
+    return(result);
+}
+
+static Arena*
+push_arena(Arena* parent, size_t size){
+    Arena* result = push_array(parent, Arena, 1);
+    init_arena(result, push_size(parent, size), size);
+    return(result);
+}
+
+// NOTE: per-thread scratch arenas, index picks a different one so a caller can hand one to a
+// callee that uses scratch too. end_scratch rolls back everything pushed since begin_scratch.
+#define SCRATCH_ARENA_COUNT 2
+#define SCRATCH_ARENA_SIZE MB(64)
+thread_local Arena* scratch_arenas[SCRATCH_ARENA_COUNT];
+
+static ScratchArena
+begin_scratch(u32 index){
+    assert(index < SCRATCH_ARENA_COUNT);
+    if(!scratch_arenas[index]){
+        scratch_arenas[index] = make_arena(SCRATCH_ARENA_SIZE);
+    }
+    ScratchArena result = {scratch_arenas[index], scratch_arenas[index]->used};
+    return(result);
+}
+
+static void
+end_scratch(ScratchArena scratch){
+    scratch.arena->used = scratch.used;
+}
+
+// --------------------------
+// strings
+// --------------------------
+
+typedef struct String8{
+    u8* str;
+    u64 size;
+} String8;
+
+typedef struct String8Node{
+    String8Node* next;
+    String8Node* prev;
+    String8 str;
+} String8Node;
+
+typedef struct FileData{
+    void* base;
+    u64 size;
+} FileData;
+
+#define str8_literal(s) String8{(u8*)(s), sizeof(s) - 1}
+
+static String8
+str8(u8* str, u64 size){
+    String8 result = {str, size};
+    return(result);
+}
+
+// NOTE: strings pushed/formatted into an arena are null terminated, size doesn't count it
+static String8
+push_string(Arena* arena, String8 string){
+    String8 result = {0};
+    result.str = push_array(arena, u8, string.size + 1);
+    result.size = string.size;
+    mem_copy(result.str, string.str, string.size);
+    result.str[result.size] = 0;
+    return(result);
+}
+
+static String8
+str8_format(Arena* arena, const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    s32 size = vsnprintf(0, 0, format, args);
+    va_end(args);
+
+    String8 result = {0};
+    if(size >= 0){
+        result.str = push_array(arena, u8, (u64)size + 1);
+        result.size = (u64)size;
+        vsnprintf((char*)result.str, (size_t)size + 1, format, args_copy);
+    }
+    va_end(args_copy);
+    return(result);
+}
+
+static String8
+str8_path_append(Arena* arena, String8 dir, String8 file){
+    String8 result = {0};
+    result.size = dir.size + 1 + file.size;
+    result.str = push_array(arena, u8, result.size + 1);
+    mem_copy(result.str, dir.str, dir.size);
+    result.str[dir.size] = '\\';
+    mem_copy(result.str + dir.size + 1, file.str, file.size);
+    result.str[result.size] = 0;
+    return(result);
+}
+
+static bool
+str8_cmp(String8 a, String8 b){
+    bool result = (a.size == b.size) && (memcmp(a.str, b.str, a.size) == 0);
+    return(result);
+}
+
+static String8
+str8_eat_spaces(String8 string){
+    while(string.size && string.str[0] == ' '){
+        string.str++;
+        string.size--;
+    }
+    return(string);
+}
+
+// NOTE: index of the first c, or size if there isn't one
+static u64
+str8_char_from_left(String8 string, u8 c){
+    u64 result = 0;
+    while(result < string.size && string.str[result] != c){
+        result++;
+    }
+    return(result);
+}
+
+static String8
+str8_split_left(String8 string, u64 count){
+    string.size = count < string.size ? count : string.size;
+    return(string);
+}
+
+static String8
+str8_advance(String8 string, u64 count){
+    count = count < string.size ? count : string.size;
+    string.str += count;
+    string.size -= count;
+    return(string);
+}
+
+// NOTE: list is the sentinel of a circular list
+static void
+dll_pop_front(String8Node* list){
+    String8Node* node = list->next;
+    if(node && node != list){
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+    }
+}
+
+#endif
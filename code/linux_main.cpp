@@ -0,0 +1,564 @@
+// NOTE: Headless Linux platform layer. Provides the same Memory/Clock/RenderBuffer/Events
+// contracts as main.cpp, but there is no window: the game runs on a fixed timestep, frames are
+// rasterized into memory and can be written out as PPM files. Used for soak tests/benchmarks.
+//
+// usage: linux_main [frame_count] [output_dir] [write_every_nth_frame]
+//        linux_main test
+// build: clang++ -std=c++17 -O2 -pthread linux_main.cpp -o roids_headless
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "linux_base_inc.h"
+
+#define SCREEN_WIDTH 1280
+#define SCREEN_HEIGHT 720
+
+#define BYTES_PER_PIXEL 4
+
+global v2s32 resolution = {
+    .x = SCREEN_WIDTH,
+    .y = SCREEN_HEIGHT
+};
+
+// --------------------------
+// os layer
+// --------------------------
+
+// NOTE: mirrors what win32_base_inc.h provides on windows. Paths in the game are built
+// with '\\', so they get turned into '/' before they hit the file system.
+#define LINUX_PATH_MAX 4096
+
+static bool
+linux_build_path(char* buffer, String8 dir, String8 file_name){
+    if(dir.size + file_name.size + 2 > LINUX_PATH_MAX){
+        return(false);
+    }
+
+    u64 at = 0;
+    for(u64 i=0; i < dir.size; ++i){
+        buffer[at++] = (char)dir.str[i];
+    }
+    if(at && buffer[at - 1] != '/' && buffer[at - 1] != '\\' && file_name.size && file_name.str[0] != '\\' && file_name.str[0] != '/'){
+        buffer[at++] = '/';
+    }
+    for(u64 i=0; i < file_name.size; ++i){
+        buffer[at++] = (char)file_name.str[i];
+    }
+    buffer[at] = 0;
+
+    for(u64 i=0; i < at; ++i){
+        if(buffer[i] == '\\'){ buffer[i] = '/'; }
+    }
+    return(true);
+}
+
+static void*
+os_virtual_alloc(size_t size){
+    void* result = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(result == MAP_FAILED){
+        result = 0;
+    }
+    return(result);
+}
+
+static Arena*
+os_make_arena(size_t size){
+    Arena* result = (Arena*)os_virtual_alloc(sizeof(Arena) + size);
+    init_arena(result, result + 1, size);
+    return(result);
+}
+
+static bool
+os_file_read(Arena* arena, FileData* data, String8 dir, String8 file_name){
+    char path[LINUX_PATH_MAX];
+    if(!linux_build_path(path, dir, file_name)){
+        return(false);
+    }
+
+    s32 file = open(path, O_RDONLY);
+    if(file == -1){
+        return(false);
+    }
+
+    bool result = false;
+    struct stat file_stat;
+    if(fstat(file, &file_stat) == 0){
+        data->size = (u64)file_stat.st_size;
+        data->base = push_array(arena, u8, (u32)data->size);
+
+        u64 total = 0;
+        while(total < data->size){
+            ssize_t bytes_read = read(file, (u8*)data->base + total, data->size - total);
+            if(bytes_read <= 0){
+                break;
+            }
+            total += (u64)bytes_read;
+        }
+        result = (total == data->size);
+    }
+    close(file);
+    return(result);
+}
+
+static bool
+os_file_write(FileData data, String8 dir, String8 file_name, u64 offset){
+    char path[LINUX_PATH_MAX];
+    if(!linux_build_path(path, dir, file_name)){
+        return(false);
+    }
+
+    s32 file = open(path, O_WRONLY|O_CREAT, 0644);
+    if(file == -1){
+        return(false);
+    }
+    ssize_t bytes_written = pwrite(file, data.base, data.size, (off_t)offset);
+    close(file);
+    return(bytes_written == (ssize_t)data.size);
+}
+
+static bool
+os_file_create(String8 dir, String8 file_name, bool overwrite){
+    char path[LINUX_PATH_MAX];
+    if(!linux_build_path(path, dir, file_name)){
+        return(false);
+    }
+
+    s32 flags = O_WRONLY|O_CREAT;
+    if(overwrite){
+        flags |= O_TRUNC;
+    }
+    s32 file = open(path, flags, 0644);
+    if(file == -1){
+        return(false);
+    }
+    close(file);
+    return(true);
+}
+
+static void
+linux_push_string_node(Arena* arena, String8Node* list, char* name){
+    // NOTE: callers hand in a zeroed sentinel
+    if(!list->next){
+        list->next = list;
+        list->prev = list;
+    }
+
+    String8Node* node = push_array(arena, String8Node, 1);
+    String8 str = {0};
+    str.size = strlen(name);
+    str.str = push_array(arena, u8, (u32)str.size + 1);
+    memcpy(str.str, name, str.size + 1);
+    node->str = str;
+
+    node->prev = list->prev;
+    node->next = list;
+    list->prev->next = node;
+    list->prev = node;
+}
+
+// NOTE: "." and ".." always come first, like FindFirstFile, callers pop them off
+static void
+os_dir_files(Arena* arena, String8Node* list, String8 dir){
+    char path[LINUX_PATH_MAX];
+    if(!linux_build_path(path, dir, str8_literal(""))){
+        return;
+    }
+
+    DIR* handle = opendir(path);
+    if(!handle){
+        return;
+    }
+    linux_push_string_node(arena, list, (char*)".");
+    linux_push_string_node(arena, list, (char*)"..");
+
+    for(struct dirent* entry = readdir(handle); entry; entry = readdir(handle)){
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0){
+            continue;
+        }
+        linux_push_string_node(arena, list, entry->d_name);
+    }
+    closedir(handle);
+}
+
+static String8
+os_get_cwd(Arena* arena){
+    String8 result = {0};
+    char buffer[LINUX_PATH_MAX];
+    if(getcwd(buffer, sizeof(buffer))){
+        result.size = strlen(buffer);
+        result.str = push_array(arena, u8, (u32)result.size + 1);
+        memcpy(result.str, buffer, result.size + 1);
+    }
+    return(result);
+}
+
+// --------------------------
+// platform contracts
+// --------------------------
+
+typedef s64 GetTicks(void);
+typedef f64 GetSecondsElapsed(s64 start, s64 end);
+typedef f64 GetMsElapsed(s64 start, s64 end);
+typedef void* MemoryReserve(size_t size);
+typedef bool MemoryCommit(void* base, size_t size);
+
+typedef struct Clock{
+    f64 dt;
+    s64 frequency;
+    GetTicks* get_ticks;
+    GetSecondsElapsed* get_seconds_elapsed;
+    GetMsElapsed* get_ms_elapsed;
+} Clock;
+
+typedef struct RenderBuffer{
+    void* base;
+    size_t size;
+
+    s32 padding;
+    s32 width;
+    s32 height;
+    s32 bytes_per_pixel;
+    s32 stride;
+
+    Arena* render_command_arena;
+    Arena* render_command_arenas[2];
+    Arena* arena;
+} RenderBuffer;
+
+typedef struct Memory{
+    void* base;
+    size_t size;
+
+    void* permanent_base;
+    size_t permanent_size;
+    void* transient_base;
+    size_t transient_size;
+
+    // NOTE: for storage that grows in place, reserve address space up front and commit as it fills
+    MemoryReserve* reserve;
+    MemoryCommit* commit;
+
+    bool initialized;
+} Memory;
+
+global bool should_quit;
+global RenderBuffer render_buffer;
+global Memory memory;
+global Clock game_clock;
+#include "input.h"
+global Events events;
+
+// --------------------------
+// work queue
+// --------------------------
+
+typedef void WorkQueueCallback(void* data);
+
+typedef struct WorkQueueEntry{
+    WorkQueueCallback* callback;
+    void* data;
+} WorkQueueEntry;
+
+#define WORK_QUEUE_ENTRIES_MAX 1024
+typedef struct WorkQueue{
+    u32 volatile completion_goal;
+    u32 volatile completion_count;
+    u32 volatile next_entry_to_write;
+    u32 volatile next_entry_to_read;
+    sem_t semaphore;
+
+    WorkQueueEntry entries[WORK_QUEUE_ENTRIES_MAX];
+} WorkQueue;
+global WorkQueue render_queue;
+
+// NOTE: single producer (the main thread), many consumers
+static void
+work_queue_add_entry(WorkQueue* queue, WorkQueueCallback* callback, void* data){
+    u32 next_entry_to_write = (queue->next_entry_to_write + 1) % WORK_QUEUE_ENTRIES_MAX;
+    assert(next_entry_to_write != queue->next_entry_to_read);
+
+    WorkQueueEntry* entry = queue->entries + queue->next_entry_to_write;
+    entry->callback = callback;
+    entry->data = data;
+    queue->completion_goal++;
+
+    __sync_synchronize();
+    queue->next_entry_to_write = next_entry_to_write;
+    sem_post(&queue->semaphore);
+}
+
+// NOTE: returns true if there was nothing to do
+static bool
+work_queue_do_next_entry(WorkQueue* queue){
+    bool should_sleep = false;
+
+    u32 original_next_entry_to_read = queue->next_entry_to_read;
+    u32 new_next_entry_to_read = (original_next_entry_to_read + 1) % WORK_QUEUE_ENTRIES_MAX;
+    if(original_next_entry_to_read != queue->next_entry_to_write){
+        u32 index = __sync_val_compare_and_swap(&queue->next_entry_to_read, original_next_entry_to_read, new_next_entry_to_read);
+        if(index == original_next_entry_to_read){
+            WorkQueueEntry entry = queue->entries[index];
+            entry.callback(entry.data);
+            __sync_fetch_and_add(&queue->completion_count, 1);
+        }
+    }
+    else{
+        should_sleep = true;
+    }
+    return(should_sleep);
+}
+
+// NOTE: main thread helps out until everything queued is done
+static void
+work_queue_complete_all(WorkQueue* queue){
+    while(queue->completion_goal != queue->completion_count){
+        work_queue_do_next_entry(queue);
+    }
+    queue->completion_goal = 0;
+    queue->completion_count = 0;
+}
+
+static void*
+work_queue_thread_proc(void* param){
+    WorkQueue* queue = (WorkQueue*)param;
+    for(;;){
+        if(work_queue_do_next_entry(queue)){
+            sem_wait(&queue->semaphore);
+        }
+    }
+    return(0);
+}
+
+static void
+init_work_queue(WorkQueue* queue, u32 thread_count){
+    queue->completion_goal = 0;
+    queue->completion_count = 0;
+    queue->next_entry_to_write = 0;
+    queue->next_entry_to_read = 0;
+    sem_init(&queue->semaphore, 0, 0);
+
+    for(u32 i=0; i < thread_count; ++i){
+        pthread_t thread;
+        pthread_create(&thread, 0, work_queue_thread_proc, queue);
+        pthread_detach(thread);
+    }
+}
+
+static u32
+get_processor_count(){
+    s64 count = sysconf(_SC_NPROCESSORS_ONLN);
+    return(count > 0 ? (u32)count : 1);
+}
+
+static s64 get_ticks(){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return(((s64)time.tv_sec * 1000000000LL) + (s64)time.tv_nsec);
+}
+
+static f64 get_seconds_elapsed(s64 end, s64 start){
+    f64 result;
+    result = ((f64)(end - start) / ((f64)game_clock.frequency));
+    return(result);
+}
+
+static f64 get_ms_elapsed(s64 start, s64 end){
+    f64 result;
+    result = (1000 * ((f64)(end - start) / ((f64)game_clock.frequency)));
+    return(result);
+}
+
+static void
+init_clock(Clock* c){
+    c->frequency = 1000000000LL;
+    c->get_ticks = get_ticks;
+    c->get_seconds_elapsed = get_seconds_elapsed;
+    c->get_ms_elapsed = get_ms_elapsed;
+}
+
+static void*
+memory_reserve(size_t size){
+    void* result = mmap(0, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if(result == MAP_FAILED){
+        result = 0;
+    }
+    return(result);
+}
+
+static bool
+memory_commit(void* base, size_t size){
+    // NOTE: mprotect wants a page aligned start, widen the range down to it
+    u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+    u64 start = (u64)base & ~(page_size - 1);
+    size += (u64)base - start;
+    bool result = mprotect((void*)start, size, PROT_READ|PROT_WRITE) == 0;
+    return(result);
+}
+
+static void
+init_memory(Memory* m){
+    m->permanent_size = MB(500);
+    m->transient_size = GB(1);
+    m->size = m->permanent_size + m->transient_size;
+    m->base = os_virtual_alloc(m->size);
+    m->permanent_base = m->base;
+    m->transient_base = (u8*)m->base + m->permanent_size;
+    m->reserve = memory_reserve;
+    m->commit = memory_commit;
+}
+
+static void
+init_render_buffer(RenderBuffer* rb, s32 width, s32 height){
+    rb->width   = width;
+    rb->height  = height;
+    rb->padding = 0;
+
+    s32 bytes_per_pixel = 4;
+    rb->bytes_per_pixel = bytes_per_pixel;
+    rb->stride = width * bytes_per_pixel;
+    rb->size   = (u32)(width * height * bytes_per_pixel);
+    rb->base   = os_virtual_alloc(rb->size);
+
+    rb->render_command_arenas[0] = make_arena(MB(16));
+    rb->render_command_arenas[1] = rb->render_command_arenas[0]; // NOTE: no render thread, one arena is enough
+    rb->render_command_arena = rb->render_command_arenas[0];
+    rb->arena = make_arena(MB(32)); // NOTE: tile bins are rebuilt here every frame
+}
+
+// NOTE: render buffer is bottom-up ARGB, PPM is top-down RGB
+static bool
+write_frame_ppm(RenderBuffer* rb, char* path){
+    FILE* file = fopen(path, "wb");
+    if(!file){
+        return(false);
+    }
+    fprintf(file, "P6\n%d %d\n255\n", rb->width, rb->height);
+
+    u8* row_rgb = (u8*)malloc((size_t)(rb->width * 3));
+    for(s32 y=rb->height - 1; y >= 0; --y){
+        u32* pixel = (u32*)((u8*)rb->base + (y * rb->stride));
+        u8* at = row_rgb;
+        for(s32 x=0; x < rb->width; ++x){
+            u32 color = *pixel++;
+            *at++ = (u8)(color >> 16);
+            *at++ = (u8)(color >> 8);
+            *at++ = (u8)(color >> 0);
+        }
+        fwrite(row_rgb, 3, (size_t)rb->width, file);
+    }
+    free(row_rgb);
+
+    fclose(file);
+    return(true);
+}
+
+global Arena* global_arena = os_make_arena(MB(1));
+#include "game.h"
+#include "tests.h"
+
+s32 main(s32 argc, char** argv){
+    // NOTE: before any threads exist, everything after this only reads cpu_features
+    detect_cpu_features(&cpu_features);
+
+    if(argc > 1 && strcmp(argv[1], "test") == 0){
+        u32 failures = run_tests();
+        return(failures ? 1 : 0);
+    }
+
+    u32 frame_count = 600;
+    char* output_dir = 0;
+    u32 write_every = 1;
+    if(argc > 1){ frame_count = (u32)atoi(argv[1]); }
+    if(argc > 2){ output_dir = argv[2]; }
+    if(argc > 3){ write_every = (u32)atoi(argv[3]); }
+    if(write_every == 0){ write_every = 1; }
+
+    init_memory(&memory);
+    init_clock(&game_clock);
+    init_render_buffer(&render_buffer, SCREEN_WIDTH, SCREEN_HEIGHT);
+    init_events(&events);
+
+    // NOTE: main thread also works the queue in work_queue_complete_all()
+    u32 processor_count = get_processor_count();
+    init_work_queue(&render_queue, processor_count > 1 ? processor_count - 1 : 1);
+
+    should_quit = false;
+
+    // NOTE: no vsync to pace us, so simulate a fixed 60Hz display on the usual 240Hz sim
+    game_clock.dt = 1.0/240.0;
+    f64 frame_dt = 1.0/60.0;
+    f64 accumulator = 0.0;
+
+    f64 sim_ms = 0;
+    f64 build_ms = 0;
+    f64 raster_ms = 0;
+    u32 frames_written = 0;
+    u64 commands_submitted = 0;
+    u64 commands_culled = 0;
+    u64 collision_pairs = 0;
+    u64 ship_asteroid_hits = 0;
+    u64 bullet_asteroid_hits = 0;
+    u64 tick_count = 0;
+
+    s64 start_ticks = game_clock.get_ticks();
+    u32 frame_index = 0;
+    for(; frame_index < frame_count && !should_quit; ++frame_index){
+        s64 sim_start = game_clock.get_ticks();
+        accumulator += frame_dt;
+        while(accumulator >= game_clock.dt){
+            update_game(&memory, &events, &game_clock);
+            accumulator -= game_clock.dt;
+
+            collision_pairs += collision_stats.pairs;
+            ship_asteroid_hits += collision_stats.ship_asteroid;
+            bullet_asteroid_hits += collision_stats.bullet_asteroid;
+            tick_count++;
+        }
+
+        s64 build_start = game_clock.get_ticks();
+        render_game(&memory, &render_buffer, (f32)(accumulator / game_clock.dt));
+
+        commands_submitted += render_cull.submitted;
+        commands_culled += render_cull.culled;
+
+        s64 raster_start = game_clock.get_ticks();
+        draw_commands_tiled(&render_buffer, render_buffer.render_command_arena, &render_queue, 0, true);
+        s64 raster_end = game_clock.get_ticks();
+
+        sim_ms    += game_clock.get_ms_elapsed(sim_start, build_start);
+        build_ms  += game_clock.get_ms_elapsed(build_start, raster_start);
+        raster_ms += game_clock.get_ms_elapsed(raster_start, raster_end);
+
+        if(output_dir && (frame_index % write_every) == 0){
+            char path[LINUX_PATH_MAX];
+            snprintf(path, sizeof(path), "%s/frame_%05u.ppm", output_dir, frame_index);
+            if(write_frame_ppm(&render_buffer, path)){
+                frames_written++;
+            }
+            else{
+                fprintf(stderr, "failed to write %s\n", path);
+            }
+        }
+    }
+    f64 total_ms = game_clock.get_ms_elapsed(start_ticks, game_clock.get_ticks());
+
+    f64 frames = frame_index ? (f64)frame_index : 1.0;
+    printf("frames: %u - written: %u - total: %.2fms\n", frame_index, frames_written, total_ms);
+    printf("per frame - sim: %.3fms - build: %.3fms - raster: %.3fms\n", sim_ms / frames, build_ms / frames, raster_ms / frames);
+    printf("per frame - commands submitted: %.1f - culled: %.1f\n", (f64)commands_submitted / frames, (f64)commands_culled / frames);
+
+    f64 ticks = tick_count ? (f64)tick_count : 1.0;
+    printf("per tick - collision pairs: %.1f - ship/asteroid: %.1f - bullet/asteroid: %.1f\n",
+           (f64)collision_pairs / ticks, (f64)ship_asteroid_hits / ticks, (f64)bullet_asteroid_hits / ticks);
+
+    return(0);
+}
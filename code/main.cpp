@@ -18,6 +18,8 @@ global v2s32 resolution = {
 typedef s64 GetTicks(void);
 typedef f64 GetSecondsElapsed(s64 start, s64 end);
 typedef f64 GetMsElapsed(s64 start, s64 end);
+typedef void* MemoryReserve(size_t size);
+typedef bool MemoryCommit(void* base, size_t size);
 
 typedef struct Clock{
     f64 dt;
@@ -39,7 +41,8 @@ typedef struct RenderBuffer{
 
     BITMAPINFO bitmap_info;
 
-    Arena* render_command_arena;
+    Arena* render_command_arena; // NOTE: the one the game is filling this frame
+    Arena* render_command_arenas[2];
     Arena* arena;
     HDC device_context;
 } RenderBuffer;
@@ -53,16 +56,121 @@ typedef struct Memory{
     void* transient_base;
     size_t transient_size;
 
+    // NOTE: for storage that grows in place, reserve address space up front and commit as it fills
+    MemoryReserve* reserve;
+    MemoryCommit* commit;
+
     bool initialized;
 } Memory;
 
 global bool should_quit;
 global RenderBuffer render_buffer;
 global Memory memory;
-global Clock clock;
+global Clock game_clock;
 #include "input.h"
 global Events events;
 
+// --------------------------
+// work queue
+// --------------------------
+
+typedef void WorkQueueCallback(void* data);
+
+typedef struct WorkQueueEntry{
+    WorkQueueCallback* callback;
+    void* data;
+} WorkQueueEntry;
+
+#define WORK_QUEUE_ENTRIES_MAX 1024
+typedef struct WorkQueue{
+    u32 volatile completion_goal;
+    u32 volatile completion_count;
+    u32 volatile next_entry_to_write;
+    u32 volatile next_entry_to_read;
+    HANDLE semaphore;
+
+    WorkQueueEntry entries[WORK_QUEUE_ENTRIES_MAX];
+} WorkQueue;
+global WorkQueue render_queue;
+
+// NOTE: single producer (whichever thread draws), many consumers
+static void
+work_queue_add_entry(WorkQueue* queue, WorkQueueCallback* callback, void* data){
+    u32 next_entry_to_write = (queue->next_entry_to_write + 1) % WORK_QUEUE_ENTRIES_MAX;
+    assert(next_entry_to_write != queue->next_entry_to_read);
+
+    WorkQueueEntry* entry = queue->entries + queue->next_entry_to_write;
+    entry->callback = callback;
+    entry->data = data;
+    queue->completion_goal++;
+
+    MemoryBarrier();
+    queue->next_entry_to_write = next_entry_to_write;
+    ReleaseSemaphore(queue->semaphore, 1, 0);
+}
+
+// NOTE: returns true if there was nothing to do
+static bool
+work_queue_do_next_entry(WorkQueue* queue){
+    bool should_sleep = false;
+
+    u32 original_next_entry_to_read = queue->next_entry_to_read;
+    u32 new_next_entry_to_read = (original_next_entry_to_read + 1) % WORK_QUEUE_ENTRIES_MAX;
+    if(original_next_entry_to_read != queue->next_entry_to_write){
+        u32 index = InterlockedCompareExchange((LONG volatile*)&queue->next_entry_to_read, new_next_entry_to_read, original_next_entry_to_read);
+        if(index == original_next_entry_to_read){
+            WorkQueueEntry entry = queue->entries[index];
+            entry.callback(entry.data);
+            InterlockedIncrement((LONG volatile*)&queue->completion_count);
+        }
+    }
+    else{
+        should_sleep = true;
+    }
+    return(should_sleep);
+}
+
+// NOTE: producer thread helps out until everything queued is done
+static void
+work_queue_complete_all(WorkQueue* queue){
+    while(queue->completion_goal != queue->completion_count){
+        work_queue_do_next_entry(queue);
+    }
+    queue->completion_goal = 0;
+    queue->completion_count = 0;
+}
+
+static DWORD WINAPI
+work_queue_thread_proc(LPVOID param){
+    WorkQueue* queue = (WorkQueue*)param;
+    for(;;){
+        if(work_queue_do_next_entry(queue)){
+            WaitForSingleObjectEx(queue->semaphore, INFINITE, FALSE);
+        }
+    }
+}
+
+static void
+init_work_queue(WorkQueue* queue, u32 thread_count){
+    queue->completion_goal = 0;
+    queue->completion_count = 0;
+    queue->next_entry_to_write = 0;
+    queue->next_entry_to_read = 0;
+    queue->semaphore = CreateSemaphoreExW(0, 0, (LONG)thread_count, 0, 0, SEMAPHORE_ALL_ACCESS);
+
+    for(u32 i=0; i < thread_count; ++i){
+        HANDLE thread = CreateThread(0, 0, work_queue_thread_proc, queue, 0, 0);
+        CloseHandle(thread);
+    }
+}
+
+static u32
+get_processor_count(){
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return((u32)info.dwNumberOfProcessors);
+}
+
 static s64 get_ticks(){
     LARGE_INTEGER result;
     QueryPerformanceCounter(&result);
@@ -71,13 +179,13 @@ static s64 get_ticks(){
 
 static f64 get_seconds_elapsed(s64 end, s64 start){
     f64 result;
-    result = ((f64)(end - start) / ((f64)clock.frequency));
+    result = ((f64)(end - start) / ((f64)game_clock.frequency));
     return(result);
 }
 
 static f64 get_ms_elapsed(s64 start, s64 end){
     f64 result;
-    result = (1000 * ((f64)(end - start) / ((f64)clock.frequency)));
+    result = (1000 * ((f64)(end - start) / ((f64)game_clock.frequency)));
     return(result);
 }
 
@@ -91,6 +199,18 @@ init_clock(Clock* c){
     c->get_ms_elapsed = get_ms_elapsed;
 }
 
+static void*
+memory_reserve(size_t size){
+    void* result = VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+    return(result);
+}
+
+static bool
+memory_commit(void* base, size_t size){
+    bool result = VirtualAlloc(base, size, MEM_COMMIT, PAGE_READWRITE) != 0;
+    return(result);
+}
+
 static void
 init_memory(Memory* m){
     m->permanent_size = MB(500);
@@ -99,6 +219,8 @@ init_memory(Memory* m){
     m->base = os_virtual_alloc(m->size);
     m->permanent_base = m->base;
     m->transient_base = (u8*)m->base + m->permanent_size;
+    m->reserve = memory_reserve;
+    m->commit = memory_commit;
 }
 
 static void
@@ -120,8 +242,10 @@ init_render_buffer(RenderBuffer* rb, s32 width, s32 height){
     rb->size   = (u32)(width * height * bytes_per_pixel);
     rb->base   = os_virtual_alloc(rb->size);
 
-    rb->render_command_arena = make_arena(MB(16));
-    rb->arena = make_arena(MB(4));
+    rb->render_command_arenas[0] = make_arena(MB(16));
+    rb->render_command_arenas[1] = make_arena(MB(16));
+    rb->render_command_arena = rb->render_command_arenas[0];
+    rb->arena = make_arena(MB(32)); // NOTE: tile bins are rebuilt here every frame
 }
 
 static void
@@ -148,6 +272,128 @@ update_window(RenderBuffer rb){
 global Arena* global_arena = os_make_arena(MB(1));
 #include "game.h"
 
+global TileDamage tile_damage = {.enabled = true};
+
+// NOTE: only blits the tiles that were redrawn this frame, adjacent dirty tiles in a row are merged into one span
+static void
+update_window_damage(RenderBuffer rb, TileDamage* damage){
+    if(!damage->enabled){
+        update_window(rb);
+        return;
+    }
+
+    s32 padding = rb.padding;
+    for(s32 tile_y=0; tile_y < damage->tile_count_y; ++tile_y){
+        s32 tile_x = 0;
+        while(tile_x < damage->tile_count_x){
+            if(!damage->dirty[tile_y * damage->tile_count_x + tile_x]){
+                ++tile_x;
+                continue;
+            }
+
+            s32 first_x = tile_x;
+            while(tile_x < damage->tile_count_x && damage->dirty[tile_y * damage->tile_count_x + tile_x]){
+                ++tile_x;
+            }
+
+            s32 x0 = first_x * RENDER_TILE_WIDTH;
+            s32 y0 = tile_y * RENDER_TILE_HEIGHT;
+            s32 x1 = tile_x * RENDER_TILE_WIDTH;
+            s32 y1 = y0 + RENDER_TILE_HEIGHT;
+            if(x1 > rb.width){ x1 = rb.width; }
+            if(y1 > rb.height){ y1 = rb.height; }
+
+            // NOTE: bottom-up DIB, source y is from the bottom, dest y is from the top
+            if(!StretchDIBits(rb.device_context,
+                              padding + x0, padding + (rb.height - y1), x1 - x0, y1 - y0,
+                              x0, y0, x1 - x0, y1 - y0,
+                              rb.base, &rb.bitmap_info, DIB_RGB_COLORS, SRCCOPY))
+            {
+                OutputDebugStringA("StrechDIBits failed\n");
+            }
+        }
+    }
+}
+
+// --------------------------
+// render thread
+// --------------------------
+
+// NOTE: Pipelined rendering. The game thread fills one command arena while the render thread
+// rasterizes and presents the other one. The arena index is handed off with an interlocked
+// exchange, the semaphores only let an idle thread sleep instead of spinning.
+#define RENDER_NOTHING_SUBMITTED 0xFFFFFFFF
+typedef struct RenderThread{
+    bool enabled;
+    u32 volatile submitted_index;
+    u32 volatile repaint_requested;
+    HANDLE submitted_semaphore; // game -> render, a frame is ready
+    HANDLE finished_semaphore;  // render -> game, the frame in flight is done and its arena can be refilled
+    u32 write_index;
+} RenderThread;
+global RenderThread render_thread;
+
+static DWORD WINAPI
+render_thread_proc(LPVOID param){
+    RenderThread* rt = (RenderThread*)param;
+    for(;;){
+        WaitForSingleObjectEx(rt->submitted_semaphore, INFINITE, FALSE);
+        u32 index = InterlockedExchange((LONG volatile*)&rt->submitted_index, RENDER_NOTHING_SUBMITTED);
+        assert(index != RENDER_NOTHING_SUBMITTED);
+
+        bool repaint = InterlockedExchange((LONG volatile*)&rt->repaint_requested, 0) != 0;
+        if(repaint){
+            tile_damage_invalidate(&tile_damage);
+        }
+
+        draw_commands_tiled(&render_buffer, render_buffer.render_command_arenas[index], &render_queue, &tile_damage, true);
+        if(repaint){
+            update_window(render_buffer);
+        }
+        else{
+            update_window_damage(render_buffer, &tile_damage);
+        }
+
+        ReleaseSemaphore(rt->finished_semaphore, 1, 0);
+    }
+}
+
+static void
+init_render_thread(RenderThread* rt){
+    rt->submitted_index = RENDER_NOTHING_SUBMITTED;
+    rt->repaint_requested = 0;
+    rt->write_index = 0;
+    rt->submitted_semaphore = CreateSemaphoreExW(0, 0, 1, 0, 0, SEMAPHORE_ALL_ACCESS);
+    rt->finished_semaphore = CreateSemaphoreExW(0, 1, 1, 0, 0, SEMAPHORE_ALL_ACCESS);
+
+    HANDLE thread = CreateThread(0, 0, render_thread_proc, rt, 0, 0);
+    CloseHandle(thread);
+    rt->enabled = true;
+}
+
+// NOTE: hands the arena the game just filled to the render thread and switches to the other one.
+// Blocks only if the render thread is still busy with the previous frame.
+static void
+render_thread_submit(RenderThread* rt){
+    WaitForSingleObjectEx(rt->finished_semaphore, INFINITE, FALSE);
+
+    MemoryBarrier();
+    InterlockedExchange((LONG volatile*)&rt->submitted_index, rt->write_index);
+    ReleaseSemaphore(rt->submitted_semaphore, 1, 0);
+
+    rt->write_index ^= 1;
+    render_buffer.render_command_arena = render_buffer.render_command_arenas[rt->write_index];
+}
+
+// NOTE: waits for the frame in flight, after this the render thread is idle
+static void
+render_thread_flush(RenderThread* rt){
+    if(rt->enabled){
+        WaitForSingleObjectEx(rt->finished_semaphore, INFINITE, FALSE);
+        ReleaseSemaphore(rt->finished_semaphore, 1, 0);
+    }
+}
+
 static LRESULT win_message_handler_callback(HWND hwnd, u32 message, u64 w_param, s64 l_param){
     LRESULT result = 0;
 
@@ -155,7 +401,14 @@ static LRESULT win_message_handler_callback(HWND hwnd, u32 message, u64 w_param,
         case WM_PAINT:{
             PAINTSTRUCT paint;
             BeginPaint(hwnd, &paint);
-            update_window(render_buffer);
+            if(render_thread.enabled){
+                // NOTE: the render thread owns the device context, it does a full present next frame
+                InterlockedExchange((LONG volatile*)&render_thread.repaint_requested, 1);
+            }
+            else{
+                update_window(render_buffer);
+                tile_damage_invalidate(&tile_damage);
+            }
             EndPaint(hwnd, &paint);
         } break;
         case WM_CLOSE:
@@ -311,24 +564,31 @@ s32 WinMain(HINSTANCE instance, HINSTANCE pinstance, LPSTR command_line, s32 win
     assert(win32_init());
     HWND window = win32_window_create(L"flux", SCREEN_WIDTH + 30, SCREEN_HEIGHT + 50);
 
+    // NOTE: before any threads exist, everything after this only reads cpu_features
+    detect_cpu_features(&cpu_features);
     init_memory(&memory);
-    init_clock(&clock);
+    init_clock(&game_clock);
     init_render_buffer(&render_buffer, SCREEN_WIDTH, SCREEN_HEIGHT);
     init_events(&events);
 
+    // NOTE: the render thread also works the queue in work_queue_complete_all(), the game thread doesn't
+    u32 processor_count = get_processor_count();
+    init_work_queue(&render_queue, processor_count > 2 ? processor_count - 2 : 1);
+
     should_quit = false;
 
     f64 FPS = 0;
     f64 MSPF = 0;
     u64 frame_count = 0;
 
-    clock.dt =  1.0/240.0;
+    game_clock.dt =  1.0/240.0;
     f64 accumulator = 0.0;
-    s64 last_ticks = clock.get_ticks();
-    s64 second_marker = clock.get_ticks();
+    s64 last_ticks = game_clock.get_ticks();
+    s64 second_marker = game_clock.get_ticks();
 	u32 simulations = 0;
 
     render_buffer.device_context = GetDC(window);
+    init_render_thread(&render_thread);
     f64 time_elapsed = 0;
     while(!should_quit){
         MSG message;
@@ -337,36 +597,44 @@ s32 WinMain(HINSTANCE instance, HINSTANCE pinstance, LPSTR command_line, s32 win
             DispatchMessage(&message);
         }
 
-        s64 now_ticks = clock.get_ticks();
-        f64 frame_time = clock.get_seconds_elapsed(now_ticks, last_ticks);
-        MSPF = 1000/1000/((f64)clock.frequency / (f64)(now_ticks - last_ticks));
+        s64 now_ticks = game_clock.get_ticks();
+        f64 frame_time = game_clock.get_seconds_elapsed(now_ticks, last_ticks);
+        MSPF = 1000/1000/((f64)game_clock.frequency / (f64)(now_ticks - last_ticks));
         last_ticks = now_ticks;
 
         accumulator += frame_time;
-        while(accumulator >= clock.dt){
-            update_game(&memory, &render_buffer, &events, &clock);
-            accumulator -= clock.dt;
-            time_elapsed += clock.dt;
+        while(accumulator >= game_clock.dt){
+            update_game(&memory, &events, &game_clock);
+            accumulator -= game_clock.dt;
+            time_elapsed += game_clock.dt;
             simulations++;
         }
 
         frame_count++;
 		simulations = 0;
-        f64 second_elapsed = clock.get_seconds_elapsed(clock.get_ticks(), second_marker);
+        f64 second_elapsed = game_clock.get_seconds_elapsed(game_clock.get_ticks(), second_marker);
         if(second_elapsed > 1){
             FPS = ((f64)frame_count / second_elapsed);
-            second_marker = clock.get_ticks();
+            second_marker = game_clock.get_ticks();
             frame_count = 0;
         }
-        //print("FPS: %f - MSPF: %f - time_dt: %f - accumulator: %lu -  frame_time: %f - second_elapsed: %f\n", FPS, MSPF, clock.dt, accumulator, frame_time, second_elapsed);
+        //print("FPS: %f - MSPF: %f - time_dt: %f - accumulator: %lu -  frame_time: %f - second_elapsed: %f\n", FPS, MSPF, game_clock.dt, accumulator, frame_time, second_elapsed);
 
-        draw_commands(&render_buffer, render_buffer.render_command_arena);
-        update_window(render_buffer);
+        // NOTE: build commands once per displayed frame, interpolated between the last two sim steps
+        render_game(&memory, &render_buffer, (f32)(accumulator / game_clock.dt));
+        if(render_thread.enabled){
+            render_thread_submit(&render_thread);
+        }
+        else{
+            draw_commands_tiled(&render_buffer, render_buffer.render_command_arena, &render_queue, &tile_damage, true);
+            update_window_damage(render_buffer, &tile_damage);
+        }
 
         if(simulations){
             //handle_debug_counters(simulations);
         }
     }
+    render_thread_flush(&render_thread);
     ReleaseDC(window, render_buffer.device_context);
 
     return(0);
@@ -36,6 +36,38 @@ make_rect(v2 min, v2 max){
     return(result);
 }
 
+// NOTE: integer pixel rect, min inclusive/max exclusive. Used for clipping.
+typedef struct RectS32{
+    s32 x0, y0;
+    s32 x1, y1;
+} RectS32;
+
+static RectS32
+make_rect_s32(s32 x0, s32 y0, s32 x1, s32 y1){
+    RectS32 result;
+    result.x0 = x0;
+    result.y0 = y0;
+    result.x1 = x1;
+    result.y1 = y1;
+    return(result);
+}
+
+static RectS32
+rect_s32_intersection(RectS32 a, RectS32 b){
+    RectS32 result = a;
+    if(result.x0 < b.x0){ result.x0 = b.x0; }
+    if(result.y0 < b.y0){ result.y0 = b.y0; }
+    if(result.x1 > b.x1){ result.x1 = b.x1; }
+    if(result.y1 > b.y1){ result.y1 = b.y1; }
+    return(result);
+}
+
+static bool
+rect_s32_has_area(RectS32 r){
+    bool result = (r.x0 < r.x1) && (r.y0 < r.y1);
+    return(result);
+}
+
 static Rect
 rect_screen_to_pixel(Rect r, v2s32 res){
     Rect result = {
@@ -68,10 +100,10 @@ rect_width_height(Rect rect){
 
 static bool
 rect_collides_rect(Rect r1, Rect r2){
-    if((r1.x0 < r2.x0 + r2.x1) &&
-       (r1.x0 + r1.x1 > r2.x0) &&
-       (r1.y0 < r2.y0 + r2.y1) &&
-       (r1.y0 + r1.y1 > r2.y0)){
+    if((r1.x0 < r2.x1) &&
+       (r1.x1 > r2.x0) &&
+       (r1.y0 < r2.y1) &&
+       (r1.y1 > r2.y0)){
         return true;
     }
     return false;
@@ -79,9 +111,9 @@ rect_collides_rect(Rect r1, Rect r2){
 
 static bool
 rect_collides_point(Rect r1, v2 p){
-    if((p.x < r1.x0 + r1.x1) &&
+    if((p.x < r1.x1) &&
        (p.x > r1.x0) &&
-       (p.y < r1.y0 + r1.y1) &&
+       (p.y < r1.y1) &&
        (p.y > r1.y0)){
         return true;
     }
@@ -91,9 +123,9 @@ rect_collides_point(Rect r1, v2 p){
 static bool
 rect_contains_rect(Rect r1, Rect r2){
     if((r2.x0 > r1.x0) &&
-       (r2.x0 + r2.x1 < r1.x0 + r1.x1) &&
+       (r2.x1 < r1.x1) &&
        (r2.y0 > r1.y0) &&
-       (r2.y0 + r2.y1 < r1.y0 + r1.y1)){
+       (r2.y1 < r1.y1)){
         return true;
     }
     return false;
@@ -3,6 +3,74 @@
 
 // NOTE: SIMD
 #include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// NOTE: AVX2 code paths are compiled per function and picked at runtime, so the
+// rest of the program can still run on SSE2 only machines.
+#if defined(__clang__) || defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+typedef struct CpuFeatures{
+    bool detected;
+    bool sse2;
+    bool avx2;
+} CpuFeatures;
+// NOTE: filled in once by the platform layer before it starts any threads, read only after that
+global CpuFeatures cpu_features;
+
+static void
+cpu_cpuid(s32 function, s32 sub_function, u32* regs){
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, function, sub_function);
+#else
+    __cpuid_count(function, sub_function, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64
+cpu_xgetbv(u32 index){
+#if defined(_MSC_VER)
+    return(_xgetbv(index));
+#else
+    u32 eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return(((u64)edx << 32) | eax);
+#endif
+}
+
+static void
+detect_cpu_features(CpuFeatures* features){
+    u32 regs[4] = {0}; // eax, ebx, ecx, edx
+    cpu_cpuid(0, 0, regs);
+    u32 max_function = regs[0];
+
+    cpu_cpuid(1, 0, regs);
+    features->sse2 = (regs[3] & (1 << 26)) != 0;
+    bool osxsave   = (regs[2] & (1 << 27)) != 0;
+    bool avx       = (regs[2] & (1 << 28)) != 0;
+    bool fma       = (regs[2] & (1 << 12)) != 0;
+
+    // NOTE: the OS has to save the ymm registers for us, otherwise AVX is unusable
+    bool os_avx = false;
+    if(osxsave && avx){
+        os_avx = (cpu_xgetbv(0) & 0x6) == 0x6;
+    }
+
+    features->avx2 = false;
+    if(os_avx && fma && max_function >= 7){
+        cpu_cpuid(7, 0, regs);
+        features->avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+    features->detected = true;
+}
 
 static RGBA
 u32_to_rgba_normal(u32 value){
@@ -46,6 +114,15 @@ linear_to_srgb(RGBA value){
     return(result);
 }
 
+static u32
+rgba_to_u32(RGBA color){
+    u32 result = (round_f32_u32(color.a * 255.0f) << 24 |
+                  round_f32_u32(color.r * 255.0f) << 16 |
+                  round_f32_u32(color.g * 255.0f) << 8 |
+                  round_f32_u32(color.b * 255.0f) << 0);
+    return(result);
+}
+
 typedef enum RenderCommandType{
     RenderCommand_ClearColor,
     RenderCommand_Pixel,
@@ -59,61 +136,74 @@ typedef enum RenderCommandType{
     RenderCommand_Triangle,
     RenderCommand_Circle,
     RenderCommand_Bitmap,
+    RenderCommand_Text,
+    RenderCommand_Layer,
 } RenderCommandType;
 
+// NOTE: Commands are packed back to back in the command arena. Each one only carries
+// what its type needs, colors are packed ARGB u32, and size is the byte offset to the
+// next command (header included). The Bitmap header is copied into the command so a
+// command never points back at entity storage, only the texels are referenced and those
+// have to outlive the frame (the render thread can still be drawing it after the push).
 typedef struct CommandHeader{
-    RenderCommandType type;
-    Rect rect;
-    v2  direction;
-    v2  origin;
-    v2  x_axis;
-    v2  y_axis;
-    s32 border_size;
-
-    f32 rad;
-
-    RGBA color;
-    RGBA border_color;
-
-    v4   clip_region;
-    bool fill;
-
-    size_t arena_used;
+    u32 type;
+    u32 size;
 } CommandHeader;
 
 typedef struct ClearColorCommand{
     CommandHeader ch;
+    u32 color;
+    bool has_region;
+    RectS32 region;
 } ClearColorCommand;
 
 typedef struct PixelCommand{
     CommandHeader ch;
+    v2 pos;
+    u32 color;
 } PixelCommand;
 
 typedef struct SegmentCommand{
     CommandHeader ch;
     v2 p0;
     v2 p1;
+    u32 color;
 } SegmentCommand;
 
 typedef struct RayCommand{
     CommandHeader ch;
+    v2 pos;
+    v2 direction;
+    u32 color;
 } RayCommand;
 
 typedef struct LineCommand{
     CommandHeader ch;
+    v2 pos;
+    v2 direction;
+    u32 color;
 } LineCommand;
 
 typedef struct RectCommand{
     CommandHeader ch;
+    Rect rect;
+    u32 color;
 } RectCommand;
 
 typedef struct BasisCommand{
     CommandHeader ch;
+    v2 origin;
+    v2 x_axis;
+    v2 y_axis;
+    u32 color;
+    bool trilinear;
     Bitmap texture;
 } BasisCommand;
 
 typedef struct BoxCommand{
     CommandHeader ch;
+    Rect rect;
+    u32 color;
 } BoxCommand;
 
 typedef struct QuadCommand{
@@ -122,6 +212,8 @@ typedef struct QuadCommand{
     v2 p1;
     v2 p2;
     v2 p3;
+    u32 color;
+    bool fill;
 } QuadCommand;
 
 typedef struct TriangleCommand{
@@ -129,113 +221,277 @@ typedef struct TriangleCommand{
     v2 p0;
     v2 p1;
     v2 p2;
+    u32 color;
+    bool fill;
 } TriangleCommand;
 
 typedef struct CircleCommand{
     CommandHeader ch;
+    v2 center;
+    v2 rad;
+    u32 color;
+    bool fill;
+    bool anti_aliased;
 } CircleCommand;
 
 typedef struct BitmapCommand{
     CommandHeader ch;
+    v2 pos;
     Bitmap texture;
 } BitmapCommand;
 
+// NOTE: A run of glyphs from one font's atlas. The glyphs follow the command in the
+// arena, positions are the pixel min corner of each glyph.
+typedef struct TextGlyph{
+    s32 x;
+    s32 y;
+    u32 codepoint;
+} TextGlyph;
+
+typedef struct TextCommand{
+    CommandHeader ch;
+    Font* font;
+    u32 color;
+    u32 glyph_count;
+    RectS32 bounds;
+} TextCommand;
+
+// NOTE: Sets the layer (z) of the commands that follow it, higher layers draw on top when
+// commands are sorted. Draws nothing, and without sorting the arena order is the draw order.
+#define RENDER_LAYER_TOP 0x7FFFFFFF
+typedef struct LayerCommand{
+    CommandHeader ch;
+    s32 z;
+} LayerCommand;
+
+static TextGlyph*
+text_command_glyphs(TextCommand* command){
+    TextGlyph* result = (TextGlyph*)(command + 1);
+    return(result);
+}
+
+// NOTE: FNV-1a
+#define HASH_SEED 0xCBF29CE484222325
+static u64
+hash_bytes(u64 hash, void* data, u32 size){
+    u8* byte = (u8*)data;
+    for(u32 i=0; i < size; ++i){
+        hash ^= *byte++;
+        hash *= 0x100000001B3;
+    }
+    return(hash);
+}
+
+// NOTE: Push time culling. A push whose conservative bounds miss the viewport returns without
+// writing a command, so an off screen entity costs a bounds test and nothing else.
+// render_cull_begin() sets the viewport (the screen for now, a camera rect once there is one)
+// and resets the counters. Nothing is culled until it has been called.
+typedef struct RenderCull{
+    bool enabled;
+    Rect viewport;
+    u32 submitted;
+    u32 culled;
+} RenderCull;
+global RenderCull render_cull;
+
+static void
+render_cull_begin(Rect viewport){
+    render_cull.enabled = true;
+    render_cull.viewport = viewport;
+    render_cull.submitted = 0;
+    render_cull.culled = 0;
+}
+
+// NOTE: true when the bounding box of points, grown by padding, misses the viewport
+static bool
+cull_points(v2* points, u32 count, f32 padding){
+    if(!render_cull.enabled){
+        return(false);
+    }
+
+    v2 min = points[0];
+    v2 max = points[0];
+    for(u32 i=1; i < count; ++i){
+        v2 p = points[i];
+        if(p.x < min.x){ min.x = p.x; }
+        if(p.y < min.y){ min.y = p.y; }
+        if(p.x > max.x){ max.x = p.x; }
+        if(p.y > max.y){ max.y = p.y; }
+    }
+
+    Rect viewport = render_cull.viewport;
+    bool result = ((max.x + padding < viewport.x0) || (max.y + padding < viewport.y0) ||
+                   (min.x - padding > viewport.x1) || (min.y - padding > viewport.y1));
+    if(result){
+        render_cull.culled++;
+    }
+    return(result);
+}
+
+// NOTE: true when the line through pos along direction misses the viewport (every corner on the
+// same side of it). For rays, also when the whole viewport is behind pos.
+static bool
+cull_line(v2 pos, v2 direction, bool ray){
+    if(!render_cull.enabled){
+        return(false);
+    }
+
+    Rect viewport = render_cull.viewport;
+    v2 corners[4] = {viewport.min, make_v2(viewport.x1, viewport.y0), make_v2(viewport.x0, viewport.y1), viewport.max};
+    f32 padding = sqrt_f32(magnitude_sqrt_v2(direction));
+    u32 above = 0;
+    u32 below = 0;
+    u32 behind = 0;
+    for(u32 i=0; i < array_count(corners); ++i){
+        v2 dist = corners[i] - pos;
+        f32 side = dot_v2(dist, perp(direction));
+        if(side > padding){ above++; }
+        if(side < -padding){ below++; }
+        if(dot_v2(dist, direction) < -padding){ behind++; }
+    }
+
+    bool result = (above == array_count(corners)) || (below == array_count(corners)) ||
+                  (ray && behind == array_count(corners));
+    if(result){
+        render_cull.culled++;
+    }
+    return(result);
+}
+
+#define push_command(arena, type, T) (T*)push_command_(arena, type, sizeof(T))
+static void*
+push_command_(Arena *arena, RenderCommandType type, u32 size){
+    CommandHeader* header = (CommandHeader*)push_array(arena, u8, size);
+    if(type != RenderCommand_Layer){
+        render_cull.submitted++;
+    }
+
+    // NOTE: zero so padding bytes are deterministic, commands get hashed for damage tracking
+    u8* byte = (u8*)header;
+    for(u32 i=0; i < size; ++i){
+        *byte++ = 0;
+    }
+
+    header->type = type;
+    header->size = size;
+    return(header);
+}
+
+static void
+push_layer(Arena *arena, s32 z){
+    LayerCommand* command = push_command(arena, RenderCommand_Layer, LayerCommand);
+    command->z = z;
+}
+
 static void
 push_clear_color(Arena *arena, RGBA color){
-    ClearColorCommand* command = push_struct(arena, ClearColorCommand);
-    command->ch.type = RenderCommand_ClearColor,
-    command->ch.arena_used = arena->used;
-    command->ch.color = color;
+    ClearColorCommand* command = push_command(arena, RenderCommand_ClearColor, ClearColorCommand);
+    command->color = rgba_to_u32(color);
 }
 
 static void
 push_clear_color_region(Arena *arena, Rect rect, RGBA color){
-    ClearColorCommand* command = push_struct(arena, ClearColorCommand);
-    command->ch.type = RenderCommand_ClearColor,
-    command->ch.color = color;
-    command->ch.rect = rect;
-    command->ch.arena_used = arena->used;
+    v2 points[] = {rect.min, rect.max};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    ClearColorCommand* command = push_command(arena, RenderCommand_ClearColor, ClearColorCommand);
+    command->color = rgba_to_u32(color);
+    command->has_region = true;
+    command->region = make_rect_s32(round_f32_s32(rect.x0), round_f32_s32(rect.y0), round_f32_s32(rect.x1), round_f32_s32(rect.y1));
 }
 
-
 static void
 push_pixel(Arena *arena, Rect rect, RGBA color){
-    PixelCommand* command = push_struct(arena, PixelCommand);
-    command->ch.type = RenderCommand_Pixel;
-    command->ch.arena_used = arena->used;
-    command->ch.rect = rect;
-    command->ch.color = color;
+    v2 points[] = {rect.min};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    PixelCommand* command = push_command(arena, RenderCommand_Pixel, PixelCommand);
+    command->pos = rect.min;
+    command->color = rgba_to_u32(color);
 }
 
 static void
 push_segment(Arena *arena, v2 p0, v2 p1, RGBA color){
-    SegmentCommand* command = push_struct(arena, SegmentCommand);
-    command->ch.type = RenderCommand_Segment;
-    command->ch.arena_used = arena->used;
-    command->ch.color = color;
+    v2 points[] = {p0, p1};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    SegmentCommand* command = push_command(arena, RenderCommand_Segment, SegmentCommand);
+    command->color = rgba_to_u32(color);
     command->p0 = p0;
     command->p1 = p1;
 }
 
 static void
 push_ray(Arena *arena, Rect rect, v2 direction, RGBA color){
-    RayCommand* command = push_struct(arena, RayCommand);
-    command->ch.type = RenderCommand_Ray;
-    command->ch.arena_used = arena->used;
-    command->ch.rect = rect;
-    command->ch.direction = direction;
-    command->ch.color = color;
+    if(cull_line(rect.min, direction, true)){
+        return;
+    }
+    RayCommand* command = push_command(arena, RenderCommand_Ray, RayCommand);
+    command->pos = rect.min;
+    command->direction = direction;
+    command->color = rgba_to_u32(color);
 }
 
 static void
 push_line(Arena *arena, Rect rect, v2 direction, RGBA color){
-    LineCommand* command = push_struct(arena, LineCommand);
-    command->ch.type = RenderCommand_Line;
-    command->ch.arena_used = arena->used;
-    command->ch.rect = rect;
-    command->ch.color = color;
-    command->ch.direction = direction;
+    if(cull_line(rect.min, direction, false)){
+        return;
+    }
+    LineCommand* command = push_command(arena, RenderCommand_Line, LineCommand);
+    command->pos = rect.min;
+    command->direction = direction;
+    command->color = rgba_to_u32(color);
 }
 
 static void
-push_rect(Arena *arena, Rect rect, RGBA color, s32 border_size = 0, RGBA border_color = {0, 0, 0, 0}){
-    RectCommand* command = push_struct(arena, RectCommand);
-    command->ch.type = RenderCommand_Rect;
-    command->ch.arena_used = arena->used;
-    command->ch.rect = rect;
-    command->ch.color = color;
-    command->ch.border_size = border_size;
-    command->ch.border_color = border_color;
+push_rect(Arena *arena, Rect rect, RGBA color){
+    v2 points[] = {rect.min, rect.max};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    RectCommand* command = push_command(arena, RenderCommand_Rect, RectCommand);
+    command->rect = rect;
+    command->color = rgba_to_u32(color);
 }
 
 static void
-push_basis(Arena *arena, v2 origin, v2 x_axis, v2 y_axis, Bitmap texture, RGBA color = {0, 0, 0, 1}){
-    BasisCommand* command = push_struct(arena, BasisCommand);
-    command->ch.type = RenderCommand_Basis;
-    command->ch.arena_used = arena->used;
-    command->ch.color = color;
-    command->ch.origin = origin;
-    command->ch.x_axis = x_axis;
-    command->ch.y_axis = y_axis;
-    command->texture = texture;
+push_basis(Arena *arena, v2 origin, v2 x_axis, v2 y_axis, Bitmap* texture, bool trilinear = false, RGBA color = {0, 0, 0, 1}){
+    v2 points[] = {origin, origin + x_axis, origin + y_axis, origin + x_axis + y_axis};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    BasisCommand* command = push_command(arena, RenderCommand_Basis, BasisCommand);
+    command->color = rgba_to_u32(color);
+    command->trilinear = trilinear;
+    command->origin = origin;
+    command->x_axis = x_axis;
+    command->y_axis = y_axis;
+    command->texture = *texture;
 }
 
 static void
 push_box(Arena *arena, Rect rect, RGBA color){
-    BoxCommand* command = push_struct(arena, BoxCommand);
-    command->ch.type = RenderCommand_Box;
-    command->ch.arena_used = arena->used;
-    command->ch.color = color;
-    command->ch.rect = rect;
+    v2 points[] = {rect.min, rect.max};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    BoxCommand* command = push_command(arena, RenderCommand_Box, BoxCommand);
+    command->color = rgba_to_u32(color);
+    command->rect = rect;
 }
 
 static void
 push_quad(Arena *arena, v2 p0, v2 p1, v2 p2, v2 p3, RGBA color, bool fill){
-    QuadCommand* command = push_struct(arena, QuadCommand);
-    command->ch.type = RenderCommand_Quad;
-    command->ch.arena_used = arena->used;
-    command->ch.color = color;
-    command->ch.fill = fill;
+    v2 points[] = {p0, p1, p2, p3};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    QuadCommand* command = push_command(arena, RenderCommand_Quad, QuadCommand);
+    command->color = rgba_to_u32(color);
+    command->fill = fill;
     command->p0 = p0;
     command->p1 = p1;
     command->p2 = p2;
@@ -244,62 +500,114 @@ push_quad(Arena *arena, v2 p0, v2 p1, v2 p2, v2 p3, RGBA color, bool fill){
 
 static void
 push_triangle(Arena *arena, v2 p0, v2 p1, v2 p2, RGBA color, bool fill){
-    TriangleCommand* command = push_struct(arena, TriangleCommand);
-    command->ch.type = RenderCommand_Triangle;
-    command->ch.arena_used = arena->used;
-    command->ch.color = color;
-    command->ch.fill = fill;
+    v2 points[] = {p0, p1, p2};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    TriangleCommand* command = push_command(arena, RenderCommand_Triangle, TriangleCommand);
+    command->color = rgba_to_u32(color);
+    command->fill = fill;
     command->p0 = p0;
     command->p1 = p1;
     command->p2 = p2;
 }
 
 static void
-push_circle(Arena *arena, Rect rect, f32 rad, RGBA color, bool fill){
-    CircleCommand* command = push_struct(arena, CircleCommand);
-    command->ch.type = RenderCommand_Circle;
-    command->ch.arena_used = arena->used;
-    command->ch.rect = rect;
-    command->ch.color = color;
-    command->ch.fill = fill;
-    command->ch.rad = rad;
+push_ellipse(Arena *arena, v2 center, v2 rad, RGBA color, bool fill, bool anti_aliased){
+    v2 points[] = {center - rad, center + rad};
+    if(cull_points(points, array_count(points), 2.0f)){
+        return;
+    }
+    CircleCommand* command = push_command(arena, RenderCommand_Circle, CircleCommand);
+    command->center = center;
+    command->color = rgba_to_u32(color);
+    command->fill = fill;
+    command->anti_aliased = anti_aliased;
+    command->rad = rad;
 }
 
 static void
-push_bitmap(Arena *arena, Rect rect, Bitmap texture){
-    BitmapCommand* command = push_struct(arena, BitmapCommand);
-    command->ch.type = RenderCommand_Bitmap;
-    command->ch.arena_used = arena->used;
-    command->ch.rect = rect;
-    command->texture = texture;
+push_circle(Arena *arena, Rect rect, f32 rad, RGBA color, bool fill, bool anti_aliased = false){
+    push_ellipse(arena, rect.min, make_v2(rad, rad), color, fill, anti_aliased);
 }
 
 static void
-push_text(Arena* command_arena, v2 pos, Font* font, String8 string){
+push_bitmap(Arena *arena, v2 pos, Bitmap* texture){
+    v2 points[] = {pos, pos + make_v2((f32)texture->width, (f32)texture->height)};
+    if(cull_points(points, array_count(points), 1.0f)){
+        return;
+    }
+    BitmapCommand* command = push_command(arena, RenderCommand_Bitmap, BitmapCommand);
+    command->pos = pos;
+    command->texture = *texture;
+}
+
+static bool
+glyph_is_visible(Font* font, u8 c){
+    bool result = (c < array_count(font->glyphs)) && font->glyphs[c].w && font->glyphs[c].h;
+    return(result);
+}
+
+static TextCommand*
+push_text_command(Arena* arena, Font* font, u32 glyph_count){
+    // NOTE: keep the next command 8 byte aligned
+    u32 size = (u32)(sizeof(TextCommand) + glyph_count * sizeof(TextGlyph));
+    size = (size + 7) & ~7u;
+
+    TextCommand* command = (TextCommand*)push_command_(arena, RenderCommand_Text, size);
+    command->font = font;
+    command->color = rgba_to_u32(font->color);
+    command->glyph_count = 0;
+    return(command);
+}
+
+static void
+text_run_add_glyph(TextGlyph* glyphs, u32* glyph_count, RectS32* run_bounds, Font* font, v2 pos, u8 c){
+    Glyph* glyph = font->glyphs + c;
+    TextGlyph* text_glyph = glyphs + *glyph_count;
+    text_glyph->x = round_f32_s32(pos.x);
+    text_glyph->y = round_f32_s32(pos.y);
+    text_glyph->codepoint = c;
+
+    RectS32 bounds = make_rect_s32(text_glyph->x, text_glyph->y, text_glyph->x + glyph->w, text_glyph->y + glyph->h);
+    if(*glyph_count == 0){
+        *run_bounds = bounds;
+    }
+    else{
+        if(bounds.x0 < run_bounds->x0){ run_bounds->x0 = bounds.x0; }
+        if(bounds.y0 < run_bounds->y0){ run_bounds->y0 = bounds.y0; }
+        if(bounds.x1 > run_bounds->x1){ run_bounds->x1 = bounds.x1; }
+        if(bounds.y1 > run_bounds->y1){ run_bounds->y1 = bounds.y1; }
+    }
+    (*glyph_count)++;
+}
+
+// NOTE: glyphs has to have room for every visible character in string
+static void
+layout_text(Font* font, String8 string, v2 pos, TextGlyph* glyphs, u32* glyph_count, RectS32* bounds){
     u8* c;
-    s32 kern;
     v2s32 unscaled_offset = {0, 0};
 
     for(u32 i=0; i < string.size; ++i){
         c = string.str + i;
         if(*c != '\n'){
-            Glyph glyph = font->glyphs[*c];
+            Glyph* glyph = font->glyphs + *c;
 
-            // setup rect to be pushed to command_arena
-            Rect rect = {
-                pos.x + (s32)round_f32_s32((unscaled_offset.x + glyph.lsb) * font->scale),
-                pos.y + (s32)(round_f32_s32(unscaled_offset.y * font->scale) - glyph.y1),
-                0, 0 // no x1, y1 needed for bitmap
+            // setup glyph position
+            v2 glyph_pos = {
+                pos.x + (f32)round_f32_s32((f32)(unscaled_offset.x + glyph->lsb) * font->scale),
+                pos.y + (f32)(round_f32_s32((f32)unscaled_offset.y * font->scale) - glyph->y1),
             };
 
             // advance x + kern
-            unscaled_offset.x += glyph.advance_width;
-            if(string.str[i + 1]){
-                kern = stbtt_GetCodepointKernAdvance(&font->info, *c, string.str[i+1]);
-                unscaled_offset.x += kern;
+            unscaled_offset.x += glyph->advance_width;
+            if(i + 1 < string.size){
+                unscaled_offset.x += font_kern(font, *c, string.str[i + 1]);
             }
 
-            push_bitmap(command_arena, rect, glyph.bitmap);
+            if(glyph_is_visible(font, *c)){
+                text_run_add_glyph(glyphs, glyph_count, bounds, font, glyph_pos, *c);
+            }
         }
         else{
             // advance to next line
@@ -309,7 +617,187 @@ push_text(Arena* command_arena, v2 pos, Font* font, String8 string){
     }
 }
 
+// NOTE: Layout cache for push_text. Layouts are stored relative to (0, 0) and offset by the
+// rounded position on the way out, so text that moves (scrolling console history) still hits.
+// Entries live in a fixed pool and the least recently used one is evicted on a miss.
+#define TEXT_LAYOUT_CHARS_MAX 128
+#define TEXT_LAYOUT_ENTRIES_MAX 256
+#define TEXT_LAYOUT_BUCKETS_MAX 256
+
+typedef struct TextLayout{
+    struct TextLayout* next_in_bucket;
+    struct TextLayout* lru_prev;
+    struct TextLayout* lru_next;
+
+    u64 hash;
+    Font* font;
+    u32 string_size;
+    u8 string[TEXT_LAYOUT_CHARS_MAX];
+
+    u32 glyph_count;
+    RectS32 bounds;
+    TextGlyph glyphs[TEXT_LAYOUT_CHARS_MAX];
+} TextLayout;
+
+typedef struct TextLayoutCache{
+    bool initialized;
+    TextLayout lru_sentinel; // NOTE: lru_next is the most recently used
+    TextLayout* buckets[TEXT_LAYOUT_BUCKETS_MAX];
+    TextLayout entries[TEXT_LAYOUT_ENTRIES_MAX];
+
+    u64 hits;
+    u64 misses;
+} TextLayoutCache;
+global TextLayoutCache text_layout_cache;
+
+static void
+text_layout_lru_remove(TextLayout* layout){
+    layout->lru_prev->lru_next = layout->lru_next;
+    layout->lru_next->lru_prev = layout->lru_prev;
+}
+
+static void
+text_layout_lru_push_front(TextLayoutCache* cache, TextLayout* layout){
+    layout->lru_prev = &cache->lru_sentinel;
+    layout->lru_next = cache->lru_sentinel.lru_next;
+    layout->lru_prev->lru_next = layout;
+    layout->lru_next->lru_prev = layout;
+}
+
+static void
+init_text_layout_cache(TextLayoutCache* cache){
+    cache->lru_sentinel.lru_next = &cache->lru_sentinel;
+    cache->lru_sentinel.lru_prev = &cache->lru_sentinel;
+    for(u32 i=0; i < TEXT_LAYOUT_BUCKETS_MAX; ++i){
+        cache->buckets[i] = 0;
+    }
+    for(u32 i=0; i < TEXT_LAYOUT_ENTRIES_MAX; ++i){
+        TextLayout* layout = cache->entries + i;
+        layout->font = 0;
+        layout->next_in_bucket = 0;
+        text_layout_lru_push_front(cache, layout);
+    }
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->initialized = true;
+}
+
+static bool
+text_layout_matches(TextLayout* layout, u64 hash, Font* font, String8 string){
+    if(layout->hash != hash || layout->font != font || layout->string_size != string.size){
+        return(false);
+    }
+    for(u32 i=0; i < string.size; ++i){
+        if(layout->string[i] != string.str[i]){
+            return(false);
+        }
+    }
+    return(true);
+}
+
+static TextLayout*
+text_layout_get(TextLayoutCache* cache, Font* font, String8 string){
+    assert(string.size <= TEXT_LAYOUT_CHARS_MAX);
+    if(!cache->initialized){
+        init_text_layout_cache(cache);
+    }
+
+    u64 hash = hash_bytes(HASH_SEED, &font, sizeof(font));
+    hash = hash_bytes(hash, string.str, (u32)string.size);
+    TextLayout** bucket = cache->buckets + (hash % TEXT_LAYOUT_BUCKETS_MAX);
+
+    for(TextLayout* layout = *bucket; layout; layout = layout->next_in_bucket){
+        if(text_layout_matches(layout, hash, font, string)){
+            text_layout_lru_remove(layout);
+            text_layout_lru_push_front(cache, layout);
+            cache->hits++;
+            return(layout);
+        }
+    }
+    cache->misses++;
+
+    // evict the least recently used entry
+    TextLayout* layout = cache->lru_sentinel.lru_prev;
+    if(layout->font){
+        TextLayout** at = cache->buckets + (layout->hash % TEXT_LAYOUT_BUCKETS_MAX);
+        while(*at != layout){
+            at = &(*at)->next_in_bucket;
+        }
+        *at = layout->next_in_bucket;
+    }
+    text_layout_lru_remove(layout);
+
+    layout->hash = hash;
+    layout->font = font;
+    layout->string_size = (u32)string.size;
+    for(u32 i=0; i < string.size; ++i){
+        layout->string[i] = string.str[i];
+    }
+    layout->glyph_count = 0;
+    layout_text(font, string, make_v2(0, 0), layout->glyphs, &layout->glyph_count, &layout->bounds);
+
+    layout->next_in_bucket = *bucket;
+    *bucket = layout;
+    text_layout_lru_push_front(cache, layout);
+    return(layout);
+}
+
+static void
+push_text(Arena* command_arena, v2 pos, Font* font, String8 string){
+    if(string.size > TEXT_LAYOUT_CHARS_MAX){
+        u32 glyph_count = 0;
+        for(u32 i=0; i < string.size; ++i){
+            if(glyph_is_visible(font, string.str[i])){ ++glyph_count; }
+        }
+        if(glyph_count){
+            TextCommand* command = push_text_command(command_arena, font, glyph_count);
+            layout_text(font, string, pos, text_command_glyphs(command), &command->glyph_count, &command->bounds);
+        }
+        return;
+    }
+
+    TextLayout* layout = text_layout_get(&text_layout_cache, font, string);
+    if(!layout->glyph_count){
+        return;
+    }
+
+    // NOTE: layouts are whole pixels, offsetting by the rounded pos lands on the same pixels as laying out at pos (up to .5 ties)
+    s32 x = round_f32_s32(pos.x);
+    s32 y = round_f32_s32(pos.y);
+
+    v2 points[] = {
+        make_v2((f32)(layout->bounds.x0 + x), (f32)(layout->bounds.y0 + y)),
+        make_v2((f32)(layout->bounds.x1 + x), (f32)(layout->bounds.y1 + y)),
+    };
+    if(cull_points(points, array_count(points), 0.0f)){
+        return;
+    }
+
+    TextCommand* command = push_text_command(command_arena, font, layout->glyph_count);
+    TextGlyph* glyphs = text_command_glyphs(command);
+    for(u32 i=0; i < layout->glyph_count; ++i){
+        glyphs[i].x = layout->glyphs[i].x + x;
+        glyphs[i].y = layout->glyphs[i].y + y;
+        glyphs[i].codepoint = layout->glyphs[i].codepoint;
+    }
+    command->glyph_count = layout->glyph_count;
+    command->bounds = make_rect_s32(layout->bounds.x0 + x, layout->bounds.y0 + y,
+                                    layout->bounds.x1 + x, layout->bounds.y1 + y);
+}
+
 static void push_text_array(Arena* command_arena, v2 pos, Font* font, String8 strings[], u32 count, bool newline_down = true){
+    u32 glyph_count = 0;
+    for(u32 i=0; i < count; ++i){
+        for(u32 j=0; j < strings[i].size; ++j){
+            if(glyph_is_visible(font, strings[i].str[j])){ ++glyph_count; }
+        }
+    }
+    if(!glyph_count){
+        return;
+    }
+
+    TextCommand* command = push_text_command(command_arena, font, glyph_count);
+
     u8* c;
     v2s32 unscaled_offset = {0, 0};
     for(u32 i=0; i < count; ++i){
@@ -318,24 +806,23 @@ static void push_text_array(Arena* command_arena, v2 pos, Font* font, String8 st
         for(u32 i=0; i < string->size; ++i){
             c = string->str + i;
             if(*c != '\n'){
-                Glyph glyph = font->glyphs[*c];
-
-                // setup rect
-                Rect rect = {
-                    pos.x + round_f32_s32((unscaled_offset.x + glyph.lsb) * font->scale),
-                    pos.y + (s32)(round_f32_s32(unscaled_offset.y * font->scale) - glyph.y1),
-                    0,
-                    0
+                Glyph* glyph = font->glyphs + *c;
+
+                // setup position
+                v2 glyph_pos = {
+                    pos.x + (f32)round_f32_s32((f32)(unscaled_offset.x + glyph->lsb) * font->scale),
+                    pos.y + (f32)(round_f32_s32((f32)unscaled_offset.y * font->scale) - glyph->y1),
                 };
 
                 // advance on x
-                unscaled_offset.x += glyph.advance_width;
-                if(string->str[i + 1]){
-                    s32 kern = stbtt_GetCodepointKernAdvance(&font->info, *c, string->str[i+1]);
-                    unscaled_offset.x += kern;
+                unscaled_offset.x += glyph->advance_width;
+                if(i + 1 < string->size){
+                    unscaled_offset.x += font_kern(font, *c, string->str[i + 1]);
                 }
 
-                push_bitmap(command_arena, rect, glyph.bitmap);
+                if(glyph_is_visible(font, *c)){
+                    text_run_add_glyph(text_command_glyphs(command), &command->glyph_count, &command->bounds, font, glyph_pos, *c);
+                }
             }
             else{
 				// advance to next line
@@ -349,309 +836,1113 @@ static void push_text_array(Arena* command_arena, v2 pos, Font* font, String8 st
     }
 }
 
-static void
-draw_pixel(RenderBuffer *render_buffer, v2 position, RGBA color){
-    v2s32 pos = round_v2_v2s32(position);
+// NOTE: Blending. Every draw routine blends through these. Colors are packed ARGB and get
+// premultiplied right before they're blended, then
+//     dest = src + dest * (255 - src.a) / 255
+// on all four channels. x * y / 255 is done as ((x * y + 0x80) * 257) >> 16, which gives the same
+// result as rounding the exact quotient, so an 8 bit blend is within 1 of the float blend
+// (test_blend_precision in tests.h). The SIMD versions do 8 (SSE2) or 16 (AVX2) channels per pmulhuw.
+static inline u32
+mul_div_255(u32 x, u32 y){
+    u32 result = ((x * y + 0x80) * 257) >> 16;
+    return(result);
+}
 
-    if(pos.x >= 0 && pos.x < render_buffer->width && pos.y >= 0 && pos.y < render_buffer->height){
-        u8 *row = (u8 *)render_buffer->base +
-                   (pos.y * render_buffer->stride) +
-                   (pos.x * render_buffer->bytes_per_pixel);
-        u32 *pixel = (u32 *)row;
+static inline u32
+premultiply_u32(u32 color){
+    u32 a = color >> 24;
+    u32 result = ((a << 24) |
+                  (mul_div_255((color >> 16) & 0xFF, a) << 16) |
+                  (mul_div_255((color >> 8) & 0xFF, a) << 8) |
+                  (mul_div_255((color >> 0) & 0xFF, a) << 0));
+    return(result);
+}
 
-        if(color.a == 1){
-            u32 new_color = (u32)(round_f32_s32(color.a * 255.0f) << 24 | round_f32_s32(color.r * 255.0f) << 16 | round_f32_s32(color.g * 255.0f) << 8 | round_f32_s32(color.b * 255.0f) << 0);
-            *pixel = new_color;
-        }
-        else if(color.a > 0){
-            f32 current_a = ((f32)((*pixel >> 24) & 0xFF) / 255.0f);
-            f32 current_r = (f32)((*pixel >> 16) & 0xFF);
-            f32 current_g = (f32)((*pixel >> 8) & 0xFF);
-            f32 current_b = (f32)((*pixel >> 0) & 0xFF);
+// NOTE: src is premultiplied
+static inline void
+blend_pixel(u32* dest, u32 src){
+    u32 inv_a = 255 - (src >> 24);
+    u32 pixel = *dest;
+    u32 result = 0;
+    for(u32 shift=0; shift < 32; shift += 8){
+        u32 channel = ((src >> shift) & 0xFF) + mul_div_255((pixel >> shift) & 0xFF, inv_a);
+        result |= channel << shift;
+    }
+    *dest = result;
+}
 
-            color.r *= 255.0f;
-            color.g *= 255.0f;
-            color.b *= 255.0f;
+// NOTE: x and y are 8 u16 channels each
+static inline __m128i
+mul_div_255_8x(__m128i x, __m128i y){
+    __m128i product = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(0x80));
+    __m128i result = _mm_mulhi_epu16(product, _mm_set1_epi16(257));
+    return(result);
+}
 
-            f32 new_r = (1 - color.a) * current_r + (color.a * color.r);
-            f32 new_g = (1 - color.a) * current_g + (color.a * color.g);
-            f32 new_b = (1 - color.a) * current_b + (color.a * color.b);
+// NOTE: blend_pixel() on 4 pixels, src is premultiplied
+static inline __m128i
+blend_4x(__m128i dest, __m128i src){
+    __m128i zero = _mm_setzero_si128();
+    __m128i max_255 = _mm_set1_epi16(255);
 
-            u32 new_color = (u32)(round_f32_s32(color.a * 255.0f) << 24 | round_f32_s32(new_r) << 16 | round_f32_s32(new_g) << 8 | round_f32_s32(new_b) << 0);
-            *pixel = new_color;
-        }
-    }
-}
+    // broadcast each pixel's src alpha to its 4 channels
+    __m128i src_lo = _mm_unpacklo_epi8(src, zero);
+    __m128i src_hi = _mm_unpackhi_epi8(src, zero);
+    __m128i inv_a_lo = _mm_sub_epi16(max_255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(src_lo, 0xFF), 0xFF));
+    __m128i inv_a_hi = _mm_sub_epi16(max_255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(src_hi, 0xFF), 0xFF));
 
-// UNTESTED: untested with rect screenspace change
-static void
-draw_line(RenderBuffer *render_buffer, Rect rect, v2 direction, RGBA color){
-    //RectPixelSpace rect_ps = screen_to_pixel(rect, resolution);
+    __m128i dest_lo = mul_div_255_8x(_mm_unpacklo_epi8(dest, zero), inv_a_lo);
+    __m128i dest_hi = mul_div_255_8x(_mm_unpackhi_epi8(dest, zero), inv_a_hi);
 
-    v2 point1 = round_v2(rect.min);
-    v2 point2 = point1;
-    v2 non_normalized_direction = make_v2(point1.x + direction.x, point1.y + direction.y);
-    direction = round_v2(non_normalized_direction);
+    // NOTE: src <= src.a and the dest term <= 255 - src.a, this can't actually saturate
+    __m128i result = _mm_adds_epu8(src, _mm_packus_epi16(dest_lo, dest_hi));
+    return(result);
+}
 
-    f32 distance_x =  abs_f32(direction.x - point1.x);
-    f32 distance_y = -abs_f32(direction.y - point1.y);
-    f32 d1_step_x = point1.x < direction.x ? 1.0f : -1.0f;
-    f32 d1_step_y = point1.y < direction.y ? 1.0f : -1.0f;
-    f32 d2_step_x = -(d1_step_x);
-    f32 d2_step_y = -(d1_step_y);
+TARGET_AVX2 static inline __m256i
+mul_div_255_16x(__m256i x, __m256i y){
+    __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(x, y), _mm256_set1_epi16(0x80));
+    __m256i result = _mm256_mulhi_epu16(product, _mm256_set1_epi16(257));
+    return(result);
+}
 
-    f32 error = distance_x + distance_y;
+// NOTE: blend_4x() on 8 pixels. unpack/shuffle/pack all stay inside their 128 bit lane, so this is
+// two blend_4x side by side.
+TARGET_AVX2 static inline __m256i
+blend_8x(__m256i dest, __m256i src){
+    __m256i zero = _mm256_setzero_si256();
+    __m256i max_255 = _mm256_set1_epi16(255);
 
-    for(;;){
-        draw_pixel(render_buffer, point1, color); // NOTE: before break, so you can draw a single point draw_segment (a pixel)
-        if(point1.x < 0 || point1.x > (f32)render_buffer->width || point1.y < 0 || point1.y > (f32)render_buffer->height)break;
+    __m256i src_lo = _mm256_unpacklo_epi8(src, zero);
+    __m256i src_hi = _mm256_unpackhi_epi8(src, zero);
+    __m256i inv_a_lo = _mm256_sub_epi16(max_255, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src_lo, 0xFF), 0xFF));
+    __m256i inv_a_hi = _mm256_sub_epi16(max_255, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src_hi, 0xFF), 0xFF));
 
-        f32 error2 = 2 * error;
-        if (error2 >= distance_y){
-            error += distance_y;
-            point1.x += d1_step_x;
-        }
-        if (error2 <= distance_x){
-            error += distance_x;
-            point1.y += d1_step_y;
-        }
-    }
-    for(;;){
-        draw_pixel(render_buffer, point2, color);
-        if(point2.x < 0 || point2.x > (f32)render_buffer->width || point2.y < 0 || point2.y > (f32)render_buffer->height)break;
+    __m256i dest_lo = mul_div_255_16x(_mm256_unpacklo_epi8(dest, zero), inv_a_lo);
+    __m256i dest_hi = mul_div_255_16x(_mm256_unpackhi_epi8(dest, zero), inv_a_hi);
 
-        f32 error2 = 2 * error;
-        if (error2 >= distance_y){
-            error += distance_y;
-            point2.x += d2_step_x;
-        }
-        if (error2 <= distance_x){
-            error += distance_x;
-            point2.y += d2_step_y;
-        }
+    __m256i result = _mm256_adds_epu8(src, _mm256_packus_epi16(dest_lo, dest_hi));
+    return(result);
+}
+
+// NOTE: src (premultiplied) scaled by coverage, 255 being full coverage
+static inline u32
+scale_premultiplied(u32 src, u32 coverage){
+    u32 result = 0;
+    for(u32 shift=0; shift < 32; shift += 8){
+        result |= mul_div_255((src >> shift) & 0xFF, coverage) << shift;
     }
+    return(result);
 }
 
-// UNTESTED: untested with rect screenspace change
-static void
-draw_ray(RenderBuffer *render_buffer, Rect rect, v2 direction, RGBA color){
-    //RectPixelSpace rect_ps = screen_to_pixel(rect, resolution);
-    v2 pos = round_v2(rect.min);
+// NOTE: premultiply_u32() on 4 pixels
+static inline __m128i
+premultiply_4x(__m128i color){
+    __m128i zero = _mm_setzero_si128();
+    __m128i alpha_mask = _mm_set1_epi32((s32)0xFF000000);
 
-    v2 non_normalized_direction = round_v2(make_v2((direction.x * 100000), (direction.y * 100000)));
-    v2 new_direction = make_v2(pos.x + non_normalized_direction.x, pos.y + non_normalized_direction.y);
+    __m128i color_lo = _mm_unpacklo_epi8(color, zero);
+    __m128i color_hi = _mm_unpackhi_epi8(color, zero);
+    __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(color_lo, 0xFF), 0xFF);
+    __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(color_hi, 0xFF), 0xFF);
 
-    f32 distance_x =  abs_f32(new_direction.x - pos.x);
-    f32 distance_y = -abs_f32(new_direction.y - pos.y);
-    f32 step_x = pos.x < new_direction.x ? 1.0f : -1.0f;
-    f32 step_y = pos.y < new_direction.y ? 1.0f : -1.0f;
+    __m128i result = _mm_packus_epi16(mul_div_255_8x(color_lo, a_lo), mul_div_255_8x(color_hi, a_hi));
+    result = _mm_or_si128(_mm_andnot_si128(alpha_mask, result), _mm_and_si128(alpha_mask, color));
+    return(result);
+}
 
-    f32 error = distance_x + distance_y;
+static void
+draw_pixel(RenderBuffer *render_buffer, RectS32 clip, v2 position, RGBA color){
+    v2s32 pos = round_v2_v2s32(position);
 
-    for(;;){
-        draw_pixel(render_buffer, make_v2(pos.x, pos.y), color); // NOTE: before break, so you can draw a single position draw_segment (a pixel)
-        if(pos.x < 0 || pos.x > (f32)render_buffer->width || pos.y < 0 || pos.y > (f32)render_buffer->height)break;
+    if(pos.x >= clip.x0 && pos.x < clip.x1 && pos.y >= clip.y0 && pos.y < clip.y1){
+        u8 *row = (u8 *)render_buffer->base +
+                   (pos.y * render_buffer->stride) +
+                   (pos.x * render_buffer->bytes_per_pixel);
+        u32 *pixel = (u32 *)row;
 
-        f32 error2 = 2 * error;
-        if (error2 >= distance_y){
-            error += distance_y;
-            pos.x += step_x;
+        u32 src = premultiply_u32(rgba_to_u32(color));
+        u32 a = src >> 24;
+        if(a == 255){
+            *pixel = src;
         }
-        if (error2 <= distance_x){
-            error += distance_x;
-            pos.y += step_y;
+        else if(a > 0){
+            blend_pixel(pixel, src);
         }
     }
 }
 
-static void
-draw_segment(RenderBuffer *render_buffer, v2 p0, v2 p1, RGBA color){
-    p0 = round_v2(p0);
-    p1 = round_v2(p1);
+// NOTE: ceil(a / b) for b > 0
+static s64
+ceil_div_s64(s64 a, s64 b){
+    s64 result = a / b;
+    if((a % b) != 0 && (a > 0)){
+        result += 1;
+    }
+    return(result);
+}
 
-    f32 distance_x =  abs_f32(p1.x - p0.x);
-    f32 distance_y = -abs_f32(p1.y - p0.y);
-    f32 step_x = p0.x < p1.x ? 1.0f : -1.0f;
-    f32 step_y = p0.y < p1.y ? 1.0f : -1.0f;
+// NOTE: Steps the line from p0 towards p1, writing pixels first..last (step 0 is p0, step n is p1, where
+// n is the length along the major axis). Pixel i sits at major = i, minor = round(i * d_minor / n)
+// (ties up), which can be evaluated at any i. That lets us solve for the range of steps that land
+// inside clip up front and start the integer error term there, so we only ever touch visible pixels,
+// write straight into the rows, and draw the exact same pixels no matter how the screen is tiled.
+static void
+draw_line_steps(RenderBuffer *render_buffer, RectS32 clip, v2s32 p0, v2s32 p1, s64 first, s64 last, RGBA color){
+    if(clip.x0 >= clip.x1 || clip.y0 >= clip.y1){
+        return;
+    }
+    u32 packed_color = premultiply_u32(rgba_to_u32(color));
+    u32 a = packed_color >> 24;
+    if(a == 0){
+        return;
+    }
 
-    f32 error = distance_x + distance_y;
+    s64 dx = (s64)p1.x - p0.x;
+    s64 dy = (s64)p1.y - p0.y;
+    s64 abs_dx = dx < 0 ? -dx : dx;
+    s64 abs_dy = dy < 0 ? -dy : dy;
+    bool x_major = abs_dx >= abs_dy;
+
+    s64 major_start   = x_major ? p0.x : p0.y;
+    s64 minor_start   = x_major ? p0.y : p0.x;
+    s64 major_sign    = (x_major ? dx : dy) < 0 ? -1 : 1;
+    s64 minor_sign    = (x_major ? dy : dx) < 0 ? -1 : 1;
+    s64 n             = x_major ? abs_dx : abs_dy;
+    s64 d             = x_major ? abs_dy : abs_dx;
+    s64 major_clip_lo = x_major ? clip.x0 : clip.y0;
+    s64 major_clip_hi = (x_major ? clip.x1 : clip.y1) - 1;
+    s64 minor_clip_lo = x_major ? clip.y0 : clip.x0;
+    s64 minor_clip_hi = (x_major ? clip.y1 : clip.x1) - 1;
+
+    if(n == 0){
+        if(first <= 0 && last >= 0 && p0.x >= clip.x0 && p0.x < clip.x1 && p0.y >= clip.y0 && p0.y < clip.y1){
+            u32* pixel = (u32*)((u8*)render_buffer->base + (p0.y * render_buffer->stride) + (p0.x * render_buffer->bytes_per_pixel));
+            if(a == 255){
+                *pixel = packed_color;
+            }
+            else{
+                blend_pixel(pixel, packed_color);
+            }
+        }
+        return;
+    }
 
-    for(;;){
-        if(p0.x == p1.x && p0.y == p1.y) break;
-        draw_pixel(render_buffer, p0, color); // NOTE: before break, so you can draw a single point draw_segment (a pixel)
+    // NOTE: clip the major axis, in steps
+    if(major_sign > 0){
+        if(first < major_clip_lo - major_start) first = major_clip_lo - major_start;
+        if(last > major_clip_hi - major_start) last = major_clip_hi - major_start;
+    }
+    else{
+        if(first < major_start - major_clip_hi) first = major_start - major_clip_hi;
+        if(last > major_start - major_clip_lo) last = major_start - major_clip_lo;
+    }
 
-        f32 error2 = 2 * error;
-        if (error2 >= distance_y){
-            error += distance_y;
-            p0.x += step_x;
-        }
-        if (error2 <= distance_x){
-            error += distance_x;
-            p0.y += step_y;
+    // NOTE: clip the minor axis. k(i) = floor((2*i*d + n) / 2n) is the minor offset at step i and
+    // never decreases, so k in [k_lo, k_hi] is also a contiguous range of steps.
+    s64 k_lo = minor_sign > 0 ? minor_clip_lo - minor_start : minor_start - minor_clip_hi;
+    s64 k_hi = minor_sign > 0 ? minor_clip_hi - minor_start : minor_start - minor_clip_lo;
+    if(k_hi < 0){
+        return;
+    }
+    if(k_lo > 0){
+        if(d == 0){
+            return;
         }
+        s64 k_lo_first = ceil_div_s64(2 * n * k_lo - n, 2 * d);
+        if(first < k_lo_first) first = k_lo_first;
+    }
+    if(d > 0){
+        s64 k_hi_last = ceil_div_s64(2 * n * (k_hi + 1) - n, 2 * d) - 1;
+        if(last > k_hi_last) last = k_hi_last;
+    }
+    if(first > last){
+        return;
     }
-}
 
-static void
-draw_flattop_triangle(RenderBuffer *render_buffer, v2 p0, v2 p1, v2 p2, RGBA color){
-    f32 left_slope = (p0.x - p2.x) / (p0.y - p2.y);
-    f32 right_slope = (p1.x - p2.x) / (p1.y - p2.y);
+    s64 numerator = 2 * first * d + n;
+    s64 k = numerator / (2 * n);
+    s64 error = numerator - k * (2 * n);
+
+    s64 x = x_major ? major_start + major_sign * first : minor_start + minor_sign * k;
+    s64 y = x_major ? minor_start + minor_sign * k : major_start + major_sign * first;
+    u8* row = (u8*)render_buffer->base + (y * render_buffer->stride) + (x * render_buffer->bytes_per_pixel);
 
-    //s32 start_y = (int)round(p2.y);
-    //s32 end_y = (int)round(p0.y);
-    s32 start_y = (s32)round_f32_s32(p2.y);
-    s32 end_y = (s32)round_f32_s32(p0.y);
+    s64 major_step = major_sign * (x_major ? render_buffer->bytes_per_pixel : render_buffer->stride);
+    s64 minor_step = minor_sign * (x_major ? render_buffer->stride : render_buffer->bytes_per_pixel);
 
-    for(s32 y=start_y; y < end_y; ++y){
-        f32 x0 = left_slope * ((f32)y + 0.5f - p0.y) + p0.x;
-        f32 x1 = right_slope * ((f32)y + 0.5f - p1.y) + p1.x;
-        s32 start_x = (s32)ceil_f32(x0 - 0.5f);
-        s32 end_x = (s32)ceil_f32(x1 - 0.5f);
-        for(s32 x=start_x; x < end_x; ++x){
-            draw_pixel(render_buffer, make_v2((f32)x, (f32)y), color);
+    for(s64 i=first; i <= last; ++i){
+        if(a == 255){
+            *(u32*)row = packed_color;
+        }
+        else{
+            blend_pixel((u32*)row, packed_color);
+        }
+
+        row += major_step;
+        error += 2 * d;
+        if(error >= 2 * n){
+            error -= 2 * n;
+            row += minor_step;
         }
     }
 }
 
+// NOTE: far enough out that a ray or line always leaves any render buffer before it gets there
+#define LINE_EXTENT (1 << 20)
+
+static v2s32
+line_far_point(v2s32 pos, v2 direction){
+    f32 length = abs_f32(direction.x) > abs_f32(direction.y) ? abs_f32(direction.x) : abs_f32(direction.y);
+    v2 far_offset = make_v2(direction.x * ((f32)LINE_EXTENT / length), direction.y * ((f32)LINE_EXTENT / length));
+    v2s32 result = {
+        .x = pos.x + round_f32_s32(far_offset.x),
+        .y = pos.y + round_f32_s32(far_offset.y),
+    };
+    return(result);
+}
+
 static void
-draw_flatbottom_triangle(RenderBuffer *render_buffer, v2 p0, v2 p1, v2 p2, RGBA color){
-    f32 left_slope = (p1.x - p0.x) / (p1.y - p0.y);
-    f32 right_slope = (p2.x - p0.x) / (p2.y - p0.y);
+draw_line(RenderBuffer *render_buffer, RectS32 clip, v2 pos, v2 direction, RGBA color){
+    v2s32 p = round_v2_v2s32(pos);
+    if(direction.x == 0 && direction.y == 0){
+        draw_line_steps(render_buffer, clip, p, p, 0, 0, color);
+        return;
+    }
 
-    //s32 start_y = (int)round(p0.y);
-    //s32 end_y = (int)round(p1.y);
-    s32 start_y = (s32)round_f32_s32(p0.y);
-    s32 end_y = (s32)round_f32_s32(p1.y);
+    v2s32 forward = line_far_point(p, direction);
+    v2s32 backward = line_far_point(p, make_v2(-direction.x, -direction.y));
+    draw_line_steps(render_buffer, clip, p, forward, 0, LINE_EXTENT, color);
+    draw_line_steps(render_buffer, clip, p, backward, 1, LINE_EXTENT, color);
+}
 
-    for(s32 y=start_y; y >= end_y; --y){
-        f32 x0 = left_slope * ((f32)y + 0.5f - p0.y) + p0.x;
-        f32 x1 = right_slope * ((f32)y + 0.5f - p0.y) + p0.x;
-        s32 start_x = (s32)ceil_f32(x0 - 0.5f);
-        s32 end_x = (s32)ceil_f32(x1 - 0.5f);
-        for(s32 x=start_x; x < end_x; ++x){
-            draw_pixel(render_buffer, make_v2((f32)x, (f32)y), color);
-        }
+static void
+draw_ray(RenderBuffer *render_buffer, RectS32 clip, v2 position, v2 direction, RGBA color){
+    v2s32 p = round_v2_v2s32(position);
+    if(direction.x == 0 && direction.y == 0){
+        draw_line_steps(render_buffer, clip, p, p, 0, 0, color);
+        return;
     }
+
+    v2s32 far_point = line_far_point(p, direction);
+    draw_line_steps(render_buffer, clip, p, far_point, 0, LINE_EXTENT, color);
 }
 
+// NOTE: p1 is not drawn, so connected segments don't double up on shared points
 static void
-draw_triangle_outlined(RenderBuffer *render_buffer, v2 p0, v2 p1, v2 p2, RGBA color, RGBA c_outlined, bool fill){
-    if(p0.y < p1.y){ swap_v2(&p0, &p1); }
-    if(p0.y < p2.y){ swap_v2(&p0, &p2); }
-    if(p1.y < p2.y){ swap_v2(&p1, &p2); }
+draw_segment(RenderBuffer *render_buffer, RectS32 clip, v2 p0, v2 p1, RGBA color){
+    v2s32 start = round_v2_v2s32(p0);
+    v2s32 end = round_v2_v2s32(p1);
+    s64 steps_x = (s64)end.x - start.x;
+    s64 steps_y = (s64)end.y - start.y;
+    if(steps_x < 0) steps_x = -steps_x;
+    if(steps_y < 0) steps_y = -steps_y;
+    s64 steps = steps_x > steps_y ? steps_x : steps_y;
+    draw_line_steps(render_buffer, clip, start, end, 0, steps - 1, color);
+}
 
-    if(fill){
-        if(p0.y == p1.y){
-            if(p0.x > p1.x){ swap_v2(&p0, &p1); }
-            draw_flattop_triangle(render_buffer, p0, p1, p2, color);
-        }
-        else if(p1.y == p2.y){
-            if(p1.x > p2.x){ swap_v2(&p1, &p2); }
-            draw_flatbottom_triangle(render_buffer, p0, p1, p2, color);
-        }
-        else{
-            f32 x = p0.x + ((p1.y - p0.y) / (p2.y - p0.y)) * (p2.x - p0.x);
-            v2 p3 = {x, p1.y};
-            if(p1.x > p3.x){ swap_v2(&p1, &p3); }
-            draw_flattop_triangle(render_buffer, p1, p3, p2, color);
-            draw_flatbottom_triangle(render_buffer, p0, p1, p3, color);
-        }
+TARGET_AVX2 static s32
+fill_span_8x(u32* dest, s32 count, u32 src){
+    __m256i src_8x = _mm256_set1_epi32((s32)src);
+    s32 x = 0;
+    for(; x + 8 <= count; x += 8){
+        __m256i pixels = _mm256_loadu_si256((__m256i*)(dest + x));
+        _mm256_storeu_si256((__m256i*)(dest + x), blend_8x(pixels, src_8x));
     }
-    draw_segment(render_buffer, p0, p1, c_outlined);
-    draw_segment(render_buffer, p1, p2, c_outlined);
-    draw_segment(render_buffer, p2, p0, c_outlined);
+    return(x);
 }
 
+// NOTE: blends count pixels of color (packed ARGB, not premultiplied) into dest. Opaque colors are
+// plain stores.
 static void
-draw_triangle(RenderBuffer *render_buffer, v2 p0, v2 p1, v2 p2, RGBA color, bool fill){
-    if(p0.y < p1.y){ swap_v2(&p0, &p1); }
-    if(p0.y < p2.y){ swap_v2(&p0, &p2); }
-    if(p1.y < p2.y){ swap_v2(&p1, &p2); }
+fill_span(u32* dest, s32 count, u32 color){
+    u32 a = color >> 24;
+    if(a == 0){
+        return;
+    }
 
-    if(fill){
-        if(p0.y == p1.y){
-            if(p0.x > p1.x){ swap_v2(&p0, &p1); }
-            draw_flattop_triangle(render_buffer, p0, p1, p2, color);
+    s32 x = 0;
+    if(a == 255){
+        __m128i color_4x = _mm_set1_epi32((s32)color);
+        for(; x + 4 <= count; x += 4){
+            _mm_storeu_si128((__m128i*)(dest + x), color_4x);
         }
-        else if(p1.y == p2.y){
-            if(p1.x > p2.x){ swap_v2(&p1, &p2); }
-            draw_flatbottom_triangle(render_buffer, p0, p1, p2, color);
-        }
-        else{
-            f32 x = p0.x + ((p1.y - p0.y) / (p2.y - p0.y)) * (p2.x - p0.x);
-            v2 p3 = {x, p1.y};
-            if(p1.x > p3.x){ swap_v2(&p1, &p3); }
-            draw_flattop_triangle(render_buffer, p1, p3, p2, color);
-            draw_flatbottom_triangle(render_buffer, p0, p1, p3, color);
+        for(; x < count; ++x){
+            dest[x] = color;
         }
+        return;
     }
-    else{
-        draw_segment(render_buffer, p0, p1, color);
-        draw_segment(render_buffer, p1, p2, color);
-        draw_segment(render_buffer, p2, p0, color);
-    }
-}
 
-static void
-clear_color(RenderBuffer *render_buffer, RGBA color={0, 0, 0, 1}){
-    u32 *pixel = (u32 *)((u8 *)(render_buffer->base));
-    for(s32 i=0; i < (render_buffer->width * render_buffer->height); ++i){
-        u32 new_color = (u32)(round_f32_s32(color.a * 255.0f) << 24 | round_f32_s32(color.r*255.0f) << 16 | round_f32_s32(color.g*255.0f) << 8 | round_f32_s32(color.b*255.0f) << 0);
-        *pixel++ = new_color;
-    }
-}
-
-// TODO: clear only a region
-// INCOMPLETE: Rect type has changed
-//static void
-//clear_color_region(RenderBuffer *render_buffer, Rect rect, RGBA color={0, 0, 0, 1}){
-//    v2s32 pos = round_v2_v2s32(rect.pos);
-//    u8 *row = (u8 *)render_buffer->base +
-//                 ((render_buffer->height - pos.y - 1) * render_buffer->stride) +
-//                 (pos.x * render_buffer->bytes_per_pixel);
-//
-//    for(s32 y=rect.y0; y < (rect.y0 + rect.y1); ++y){
-//        u32* pixel = (u32*)row;
-//        for(s32 x=rect.x0; x < (rect.x0 + rect.x1); ++x){
-//            u32 new_color = (round_f32_s32(color.a * 255.0f) << 24 | round_f32_s32(color.r*255.0f) << 16 | round_f32_s32(color.g*255.0f) << 8 | round_f32_s32(color.b*255.0f) << 0);
-//            *pixel++ = new_color;
-//        }
-//        row += render_buffer->stride;
-//    }
-//}
+    u32 src = premultiply_u32(color);
+    if(cpu_features.avx2){
+        x = fill_span_8x(dest, count, src);
+    }
 
+    __m128i src_4x = _mm_set1_epi32((s32)src);
+    for(; x + 4 <= count; x += 4){
+        __m128i pixels = _mm_loadu_si128((__m128i*)(dest + x));
+        _mm_storeu_si128((__m128i*)(dest + x), blend_4x(pixels, src_4x));
+    }
 
+    for(; x < count; ++x){
+        blend_pixel(dest + x, src);
+    }
+}
+
+// NOTE: floor(a / b) for b > 0
+static s64
+floor_div_s64(s64 a, s64 b){
+    s64 result = a / b;
+    if((a % b) != 0 && (a < 0)){
+        result -= 1;
+    }
+    return(result);
+}
+
+// NOTE: Half-space triangle fill. Vertices are snapped to 1/16th of a pixel and every row's
+// span is solved exactly from the three edge functions at the pixel centers, then filled with
+// fill_span(). Top-left fill rule (for counter clockwise triangles, y up): pixel centers exactly
+// on a left edge (going down) or a top edge (horizontal, going left) are in, so triangles that
+// share an edge never touch the same pixel twice.
+#define RASTER_SUBPIXEL_BITS 4
+#define RASTER_SUBPIXEL_ONE (1 << RASTER_SUBPIXEL_BITS)
+
+typedef struct RasterEdge{
+    s64 x0, y0;
+    s64 dx, dy;
+    s64 bias;
+} RasterEdge;
+
+static RasterEdge
+make_raster_edge(s64 x0, s64 y0, s64 x1, s64 y1){
+    RasterEdge result;
+    result.x0 = x0;
+    result.y0 = y0;
+    result.dx = x1 - x0;
+    result.dy = y1 - y0;
+
+    bool left = result.dy < 0;
+    bool top = (result.dy == 0) && (result.dx < 0);
+    result.bias = (left || top) ? 0 : -1;
+    return(result);
+}
+
+// NOTE: narrows [*x_min, *x_max) to the pixels of row y that are inside edge
 static void
-draw_bitmap(RenderBuffer *render_buffer, v2 pos, Bitmap* texture){
-    Rect rect = make_rect(pos.x, pos.y, pos.x + (f32)texture->width, pos.y + (f32)texture->height);
-    v2s32 pixel_min = round_v2_v2s32(rect.min);
-    v2s32 pixel_max = round_v2_v2s32(rect.max);
+raster_edge_clip_span(RasterEdge* edge, s32 y, s32* x_min, s32* x_max){
+    // E(x) = dx*(center_y - y0) - dy*(center_x - x0) = a*x + b, inside when E + bias >= 0
+    s64 center_y = ((s64)y << RASTER_SUBPIXEL_BITS) + (RASTER_SUBPIXEL_ONE / 2);
+    s64 a = -edge->dy * RASTER_SUBPIXEL_ONE;
+    s64 b = edge->dx * (center_y - edge->y0) - edge->dy * ((RASTER_SUBPIXEL_ONE / 2) - edge->x0) + edge->bias;
+
+    if(a > 0){
+        // x >= -b/a
+        s64 first = -floor_div_s64(b, a);
+        if(first > *x_min){ *x_min = (s32)(first < *x_max ? first : *x_max); }
+    }
+    else if(a < 0){
+        // x <= b/-a
+        s64 last = floor_div_s64(b, -a) + 1;
+        if(last < *x_max){ *x_max = (s32)(last > *x_min ? last : *x_min); }
+    }
+    else if(b < 0){
+        *x_max = *x_min;
+    }
+}
 
-    u32* at = (u32*)texture->base;
-    for(s32 y=pixel_min.y; y < pixel_max.y; ++y){
-        for(s32 x=pixel_min.x; x < pixel_max.x; ++x){
-            RGBA color = u32_to_rgba_normal(*at++);
-            draw_pixel(render_buffer, make_v2((f32)x, (f32)y), color);
+static void
+fill_triangle(RenderBuffer *render_buffer, RectS32 clip, v2 p0, v2 p1, v2 p2, RGBA color){
+    f32 subpixel = (f32)RASTER_SUBPIXEL_ONE;
+    s64 x0 = round_f32_s32(p0.x * subpixel);
+    s64 y0 = round_f32_s32(p0.y * subpixel);
+    s64 x1 = round_f32_s32(p1.x * subpixel);
+    s64 y1 = round_f32_s32(p1.y * subpixel);
+    s64 x2 = round_f32_s32(p2.x * subpixel);
+    s64 y2 = round_f32_s32(p2.y * subpixel);
+
+    // make it counter clockwise
+    s64 area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+    if(area == 0){
+        return;
+    }
+    if(area < 0){
+        s64 x = x1; x1 = x2; x2 = x;
+        s64 y = y1; y1 = y2; y2 = y;
+    }
+
+    RasterEdge edges[3] = {
+        make_raster_edge(x0, y0, x1, y1),
+        make_raster_edge(x1, y1, x2, y2),
+        make_raster_edge(x2, y2, x0, y0),
+    };
+
+    // rows whose centers can be inside, clamped to clip
+    s64 min_y = y0; if(y1 < min_y){ min_y = y1; } if(y2 < min_y){ min_y = y2; }
+    s64 max_y = y0; if(y1 > max_y){ max_y = y1; } if(y2 > max_y){ max_y = y2; }
+    s64 row_min = floor_div_s64(min_y, RASTER_SUBPIXEL_ONE);
+    s64 row_max = floor_div_s64(max_y, RASTER_SUBPIXEL_ONE) + 1;
+    if(row_min < clip.y0){ row_min = clip.y0; }
+    if(row_max > clip.y1){ row_max = clip.y1; }
+
+    u32 packed_color = rgba_to_u32(color);
+    for(s32 y=(s32)row_min; y < (s32)row_max; ++y){
+        s32 x_min = clip.x0;
+        s32 x_max = clip.x1;
+        raster_edge_clip_span(edges + 0, y, &x_min, &x_max);
+        raster_edge_clip_span(edges + 1, y, &x_min, &x_max);
+        raster_edge_clip_span(edges + 2, y, &x_min, &x_max);
+
+        if(x_min < x_max){
+            u32* row = (u32*)((u8*)render_buffer->base + (y * render_buffer->stride) + (x_min * render_buffer->bytes_per_pixel));
+            fill_span(row, x_max - x_min, packed_color);
+        }
+    }
+}
+
+static void
+draw_triangle_outlined(RenderBuffer *render_buffer, RectS32 clip, v2 p0, v2 p1, v2 p2, RGBA color, RGBA c_outlined, bool fill){
+    if(fill){
+        fill_triangle(render_buffer, clip, p0, p1, p2, color);
+    }
+    draw_segment(render_buffer, clip, p0, p1, c_outlined);
+    draw_segment(render_buffer, clip, p1, p2, c_outlined);
+    draw_segment(render_buffer, clip, p2, p0, c_outlined);
+}
+
+static void
+draw_triangle(RenderBuffer *render_buffer, RectS32 clip, v2 p0, v2 p1, v2 p2, RGBA color, bool fill){
+    if(fill){
+        fill_triangle(render_buffer, clip, p0, p1, p2, color);
+    }
+    else{
+        draw_segment(render_buffer, clip, p0, p1, color);
+        draw_segment(render_buffer, clip, p1, p2, color);
+        draw_segment(render_buffer, clip, p2, p0, color);
+    }
+}
+
+// NOTE: Clears bigger than this are not going to be read back before they fall out of cache, so they
+// go out with non temporal stores that skip it. Anything smaller (a tile) is about to be drawn over,
+// so it's better left in cache.
+#define CLEAR_STREAMING_MIN_BYTES KB(512)
+
+TARGET_AVX2 static void
+clear_rows_8x(u8* row, s32 stride, s32 width, s32 height, u32 color, bool streaming){
+    __m256i color_8x = _mm256_set1_epi32((s32)color);
+    for(s32 y=0; y < height; ++y){
+        u32* pixel = (u32*)row;
+        s32 x = 0;
+        if(streaming){
+            for(; x < width && ((u64)(pixel + x) & 31); ++x){
+                pixel[x] = color;
+            }
+            for(; x + 8 <= width; x += 8){
+                _mm256_stream_si256((__m256i*)(pixel + x), color_8x);
+            }
+        }
+        else{
+            for(; x + 8 <= width; x += 8){
+                _mm256_storeu_si256((__m256i*)(pixel + x), color_8x);
+            }
+        }
+        for(; x < width; ++x){
+            pixel[x] = color;
+        }
+        row += stride;
+    }
+}
+
+static void
+clear_rows_4x(u8* row, s32 stride, s32 width, s32 height, u32 color, bool streaming){
+    __m128i color_4x = _mm_set1_epi32((s32)color);
+    for(s32 y=0; y < height; ++y){
+        u32* pixel = (u32*)row;
+        s32 x = 0;
+        if(streaming){
+            for(; x < width && ((u64)(pixel + x) & 15); ++x){
+                pixel[x] = color;
+            }
+            for(; x + 4 <= width; x += 4){
+                _mm_stream_si128((__m128i*)(pixel + x), color_4x);
+            }
+        }
+        else{
+            for(; x + 4 <= width; x += 4){
+                _mm_storeu_si128((__m128i*)(pixel + x), color_4x);
+            }
+        }
+        for(; x < width; ++x){
+            pixel[x] = color;
+        }
+        row += stride;
+    }
+}
+
+static void
+clear_color(RenderBuffer *render_buffer, RectS32 clip, u32 color){
+    if(!rect_s32_has_area(clip)){
+        return;
+    }
+
+    s32 width = clip.x1 - clip.x0;
+    s32 height = clip.y1 - clip.y0;
+    u8 *row = (u8 *)render_buffer->base +
+              (clip.y0 * render_buffer->stride) +
+              (clip.x0 * render_buffer->bytes_per_pixel);
+    bool streaming = ((s64)width * height * render_buffer->bytes_per_pixel) >= (s64)CLEAR_STREAMING_MIN_BYTES;
+
+    assert(cpu_features.detected);
+    if(cpu_features.avx2){
+        clear_rows_8x(row, render_buffer->stride, width, height, color, streaming);
+    }
+    else if(cpu_features.sse2){
+        clear_rows_4x(row, render_buffer->stride, width, height, color, streaming);
+    }
+    else{
+        for(s32 y=0; y < height; ++y){
+            u32 *pixel = (u32 *)row;
+            for(s32 x=0; x < width; ++x){
+                *pixel++ = color;
+            }
+            row += render_buffer->stride;
+        }
+    }
+
+    if(streaming){
+        // NOTE: non temporal stores are weakly ordered, make them visible before anyone reads the buffer
+        _mm_sfence();
+    }
+}
+
+static void
+clear_color_region(RenderBuffer *render_buffer, RectS32 clip, RectS32 region, u32 color){
+    clear_color(render_buffer, rect_s32_intersection(clip, region), color);
+}
+
+static void
+draw_bitmap(RenderBuffer *render_buffer, RectS32 clip, v2 pos, Bitmap* texture){
+    assert(texture->format == BitmapFormat_Straight || texture->format == BitmapFormat_Premultiplied);
+    v2s32 pixel_min = round_v2_v2s32(pos);
+    RectS32 bitmap_rect = make_rect_s32(pixel_min.x, pixel_min.y, pixel_min.x + texture->width, pixel_min.y + texture->height);
+    RectS32 draw_rect = rect_s32_intersection(bitmap_rect, clip);
+    if(!rect_s32_has_area(draw_rect)){
+        return;
+    }
+
+    for(s32 y=draw_rect.y0; y < draw_rect.y1; ++y){
+        u32* texel = (u32*)((u8*)texture->base + ((y - bitmap_rect.y0) * texture->stride)) + (draw_rect.x0 - bitmap_rect.x0);
+        u32* pixel = (u32*)((u8*)render_buffer->base + (y * render_buffer->stride) + (draw_rect.x0 * render_buffer->bytes_per_pixel));
+
+        s32 count = draw_rect.x1 - draw_rect.x0;
+        s32 x = 0;
+        if(texture->format == BitmapFormat_Premultiplied){
+            for(; x + 4 <= count; x += 4){
+                __m128i src = _mm_loadu_si128((__m128i*)(texel + x));
+                __m128i dest = _mm_loadu_si128((__m128i*)(pixel + x));
+                _mm_storeu_si128((__m128i*)(pixel + x), blend_4x(dest, src));
+            }
+            for(; x < count; ++x){
+                blend_pixel(pixel + x, texel[x]);
+            }
+        }
+        else{
+            for(; x + 4 <= count; x += 4){
+                __m128i src = premultiply_4x(_mm_loadu_si128((__m128i*)(texel + x)));
+                __m128i dest = _mm_loadu_si128((__m128i*)(pixel + x));
+                _mm_storeu_si128((__m128i*)(pixel + x), blend_4x(dest, src));
+            }
+            for(; x < count; ++x){
+                blend_pixel(pixel + x, premultiply_u32(texel[x]));
+            }
+        }
+    }
+}
+
+
+// NOTE: blends color (packed ARGB, not premultiplied) into dest, scaled by one coverage byte per
+// pixel. 4 pixels at a time, blocks with no coverage are skipped and full coverage of an opaque
+// color is a plain store.
+static void
+blend_coverage_span(u32* dest, u8* coverage, s32 count, u32 color){
+    u32 src = premultiply_u32(color);
+    bool opaque = (src >> 24) == 255;
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i src_2x = _mm_unpacklo_epi8(_mm_set1_epi32((s32)src), zero);
+    __m128i src_4x = _mm_set1_epi32((s32)src);
+
+    s32 x = 0;
+    for(; x + 4 <= count; x += 4){
+        u32 coverage_4x = *(u32*)(coverage + x);
+        if(coverage_4x == 0){
+            continue;
+        }
+        if(coverage_4x == 0xFFFFFFFF && opaque){
+            _mm_storeu_si128((__m128i*)(dest + x), src_4x);
+            continue;
+        }
+
+        // broadcast each pixel's coverage to its 4 channels
+        __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128((s32)coverage_4x), zero);
+        c = _mm_unpacklo_epi16(c, c);
+        __m128i c_lo = _mm_unpacklo_epi32(c, c);
+        __m128i c_hi = _mm_unpackhi_epi32(c, c);
+
+        __m128i scaled_src = _mm_packus_epi16(mul_div_255_8x(src_2x, c_lo), mul_div_255_8x(src_2x, c_hi));
+        __m128i pixels = _mm_loadu_si128((__m128i*)(dest + x));
+        _mm_storeu_si128((__m128i*)(dest + x), blend_4x(pixels, scaled_src));
+    }
+
+    for(; x < count; ++x){
+        if(coverage[x] == 0){
+            continue;
+        }
+        blend_pixel(dest + x, scale_premultiplied(src, coverage[x]));
+    }
+}
+
+static void
+draw_text(RenderBuffer *render_buffer, RectS32 clip, TextCommand* command){
+    Font* font = command->font;
+    TextGlyph* text_glyphs = text_command_glyphs(command);
+
+    for(u32 i=0; i < command->glyph_count; ++i){
+        TextGlyph* text_glyph = text_glyphs + i;
+        Glyph* glyph = font->glyphs + text_glyph->codepoint;
+
+        RectS32 glyph_rect = make_rect_s32(text_glyph->x, text_glyph->y, text_glyph->x + glyph->w, text_glyph->y + glyph->h);
+        RectS32 draw_rect = rect_s32_intersection(glyph_rect, clip);
+        if(!rect_s32_has_area(draw_rect)){
+            continue;
+        }
+
+        for(s32 y=draw_rect.y0; y < draw_rect.y1; ++y){
+            s32 atlas_y = glyph->atlas_y + (y - glyph_rect.y0);
+            AtlasSpan span = font->atlas_spans[atlas_y];
+
+            s32 x0 = glyph_rect.x0 + span.x0;
+            s32 x1 = glyph_rect.x0 + span.x1;
+            if(x0 < draw_rect.x0){ x0 = draw_rect.x0; }
+            if(x1 > draw_rect.x1){ x1 = draw_rect.x1; }
+            if(x0 >= x1){
+                continue;
+            }
+
+            u32* dest = (u32*)((u8*)render_buffer->base + (y * render_buffer->stride) + (x0 * render_buffer->bytes_per_pixel));
+            u8* coverage = (u8*)font->atlas.base + (atlas_y * font->atlas.stride) + (x0 - glyph_rect.x0);
+            blend_coverage_span(dest, coverage, x1 - x0, command->color);
+        }
+    }
+}
+
+// NOTE: BitmapFormat_Linear16 texel, u16 b, g, r, a from the low bits up
+static RGBA
+linear16_to_rgba(u64 texel){
+    f32 inv_65535 = 1.0f / 65535.0f;
+    RGBA result = {
+        .r = (f32)((texel >> 32) & 0xFFFF) * inv_65535,
+        .g = (f32)((texel >> 16) & 0xFFFF) * inv_65535,
+        .b = (f32)((texel >> 0) & 0xFFFF) * inv_65535,
+        .a = (f32)((texel >> 48) & 0xFFFF) * inv_65535,
+    };
+    return(result);
+}
+
+// NOTE: Texel pairs for the wide draw_bitmap paths. Each lane's left and right texels sit next to each
+// other in a BitmapFormat_Linear16 row (or block row), so one 128 bit load per lane per row gets both, no gathers.
+// Four of those (lanes 0..3) transposed to one channel per register, left texel and right texel.
+// Values stay in 0..65535, the wide paths scale once after filtering.
+typedef struct TexelPair4x{
+    __m128 left_r, left_g, left_b, left_a;
+    __m128 right_r, right_g, right_b, right_a;
+} TexelPair4x;
+
+static inline TexelPair4x
+unpack_linear16_pairs_4x(__m128i pair0, __m128i pair1, __m128i pair2, __m128i pair3){
+    __m128i zero = _mm_setzero_si128();
+
+    // left texels: b0 b1 g0 g1 r0 r1 a0 a1, right texels the same in the hi half
+    __m128i left01  = _mm_unpacklo_epi16(pair0, pair1);
+    __m128i right01 = _mm_unpackhi_epi16(pair0, pair1);
+    __m128i left23  = _mm_unpacklo_epi16(pair2, pair3);
+    __m128i right23 = _mm_unpackhi_epi16(pair2, pair3);
+
+    // b0 b1 b2 b3 g0 g1 g2 g3 / r0 r1 r2 r3 a0 a1 a2 a3
+    __m128i left_bg  = _mm_unpacklo_epi32(left01, left23);
+    __m128i left_ra  = _mm_unpackhi_epi32(left01, left23);
+    __m128i right_bg = _mm_unpacklo_epi32(right01, right23);
+    __m128i right_ra = _mm_unpackhi_epi32(right01, right23);
+
+    TexelPair4x result;
+    result.left_b  = _mm_cvtepi32_ps(_mm_unpacklo_epi16(left_bg, zero));
+    result.left_g  = _mm_cvtepi32_ps(_mm_unpackhi_epi16(left_bg, zero));
+    result.left_r  = _mm_cvtepi32_ps(_mm_unpacklo_epi16(left_ra, zero));
+    result.left_a  = _mm_cvtepi32_ps(_mm_unpackhi_epi16(left_ra, zero));
+    result.right_b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(right_bg, zero));
+    result.right_g = _mm_cvtepi32_ps(_mm_unpackhi_epi16(right_bg, zero));
+    result.right_r = _mm_cvtepi32_ps(_mm_unpacklo_epi16(right_ra, zero));
+    result.right_a = _mm_cvtepi32_ps(_mm_unpackhi_epi16(right_ra, zero));
+    return(result);
+}
+
+typedef struct TexelPair8x{
+    __m256 left_r, left_g, left_b, left_a;
+    __m256 right_r, right_g, right_b, right_a;
+} TexelPair8x;
+
+// NOTE: unpack_linear16_pairs_4x() on 8 lanes. pair_n holds lane n in its low 128 bits and lane
+// n + 4 in the high 128 bits, every unpack stays inside its 128 bit half, so the result comes out
+// in lane order.
+TARGET_AVX2 static inline TexelPair8x
+unpack_linear16_pairs_8x(__m256i pair0, __m256i pair1, __m256i pair2, __m256i pair3){
+    __m256i zero = _mm256_setzero_si256();
+
+    __m256i left01  = _mm256_unpacklo_epi16(pair0, pair1);
+    __m256i right01 = _mm256_unpackhi_epi16(pair0, pair1);
+    __m256i left23  = _mm256_unpacklo_epi16(pair2, pair3);
+    __m256i right23 = _mm256_unpackhi_epi16(pair2, pair3);
+
+    __m256i left_bg  = _mm256_unpacklo_epi32(left01, left23);
+    __m256i left_ra  = _mm256_unpackhi_epi32(left01, left23);
+    __m256i right_bg = _mm256_unpacklo_epi32(right01, right23);
+    __m256i right_ra = _mm256_unpackhi_epi32(right01, right23);
+
+    TexelPair8x result;
+    result.left_b  = _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(left_bg, zero));
+    result.left_g  = _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(left_bg, zero));
+    result.left_r  = _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(left_ra, zero));
+    result.left_a  = _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(left_ra, zero));
+    result.right_b = _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(right_bg, zero));
+    result.right_g = _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(right_bg, zero));
+    result.right_r = _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(right_ra, zero));
+    result.right_a = _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(right_ra, zero));
+    return(result);
+}
+
+TARGET_AVX2 static inline __m256i
+load_texel_pair_8x(u8* lane_lo, u8* lane_hi){
+    __m256i result = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i*)lane_lo)), _mm_loadu_si128((__m128i*)lane_hi), 1);
+    return(result);
+}
+
+// NOTE: Which mip level(s) a basis draw samples. The basis is affine, so texels per pixel along each
+// axis is the same everywhere and we pick once per draw instead of per pixel. level is the largest
+// level that is still at least one texel per pixel (floor of the lod, stays sharp), next_level and t are
+// the trilinear blend towards the next smaller level, next_level is 0 when there is nothing to blend.
+typedef struct TextureLod{
+    Bitmap* level;
+    Bitmap* next_level;
+    f32 t;
+} TextureLod;
+
+static TextureLod
+select_texture_lod(Bitmap* texture, v2 x_axis, v2 y_axis, bool trilinear){
+    TextureLod result = {0};
+    result.level = texture;
+    if(texture->mip_count <= 1){
+        return(result);
+    }
+
+    f32 texels_per_pixel_x = (f32)texture->width / sqrt_f32(magnitude_sqrt_v2(x_axis));
+    f32 texels_per_pixel_y = (f32)texture->height / sqrt_f32(magnitude_sqrt_v2(y_axis));
+    f32 rho = (texels_per_pixel_x > texels_per_pixel_y) ? texels_per_pixel_x : texels_per_pixel_y;
+
+    u32 level = 0;
+    while(rho >= 2.0f && level + 1 < texture->mip_count){
+        rho *= 0.5f;
+        ++level;
+    }
+    result.level = texture->mips + level;
+
+    // NOTE: with a level left below us rho ends up in 1..2 (below 1 is magnifying), rho - 1 is close
+    // enough to the fractional lod for a blend weight
+    if(trilinear && rho > 1.0f && level + 1 < texture->mip_count){
+        result.next_level = texture->mips + level + 1;
+        result.t = rho - 1.0f;
+    }
+    return(result);
+}
+
+// NOTE: what the wide samplers need from one Linear16/Linear16Block level, pulled out of the Bitmap.
+// The kernels store pixels through u32 pointers, which may alias the Bitmap's s32 fields, so reading
+// them off the Bitmap means reloading them for every chunk of pixels.
+typedef struct TextureSampler{
+    u8* base;
+    f32 width;
+    f32 height;
+    s32 level_stride; // NOTE: bytes per texel row, per block row for Linear16Block
+    s32 fetch_stride; // NOTE: bytes from a texel to the one above it
+    bool block;
+} TextureSampler;
+
+static TextureSampler
+make_texture_sampler(Bitmap* level){
+    TextureSampler result;
+    result.base = level->base;
+    result.width = (f32)level->width;
+    result.height = (f32)level->height;
+    result.level_stride = level->stride;
+    result.block = (level->format == BitmapFormat_Linear16Block);
+    result.fetch_stride = result.block ? TEXEL_BLOCK_PITCH * (s32)sizeof(u64) : level->stride;
+    return(result);
+}
+
+// NOTE: a TextureLod with its levels turned into samplers
+typedef struct SamplerLod{
+    TextureSampler level;
+    TextureSampler next_level;
+    bool has_next_level;
+    f32 t;
+} SamplerLod;
+
+static SamplerLod
+make_sampler_lod(TextureLod lod){
+    SamplerLod result = {0};
+    result.level = make_texture_sampler(lod.level);
+    if(lod.next_level){
+        result.next_level = make_texture_sampler(lod.next_level);
+        result.has_next_level = true;
+        result.t = lod.t;
+    }
+    return(result);
+}
+
+// NOTE: samplers for every level of one texture, set up once for a run of draws that share its texels
+#define TEXTURE_SAMPLER_LEVELS_MAX 16
+typedef struct TextureSamplers{
+    Bitmap* mips;
+    u32 mip_count;
+    TextureSampler texture; // NOTE: textures without a mip chain
+    TextureSampler levels[TEXTURE_SAMPLER_LEVELS_MAX];
+} TextureSamplers;
+
+static void
+init_texture_samplers(TextureSamplers* samplers, Bitmap* texture){
+    assert(texture->mip_count <= TEXTURE_SAMPLER_LEVELS_MAX);
+    samplers->mips = texture->mips;
+    samplers->mip_count = texture->mip_count;
+    samplers->texture = make_texture_sampler(texture);
+    for(u32 level=0; level < texture->mip_count; ++level){
+        samplers->levels[level] = make_texture_sampler(texture->mips + level);
+    }
+}
+
+// NOTE: level has to come out of select_texture_lod() on a texture with the same texels
+static TextureSampler
+texture_samplers_level(TextureSamplers* samplers, Bitmap* level){
+    TextureSampler result = samplers->texture;
+    if(samplers->mip_count > 1){
+        u32 index = (u32)(level - samplers->mips);
+        assert(index < samplers->mip_count);
+        result = samplers->levels[index];
+    }
+    return(result);
+}
+
+static SamplerLod
+texture_samplers_lod(TextureSamplers* samplers, TextureLod lod){
+    SamplerLod result = {0};
+    result.level = texture_samplers_level(samplers, lod.level);
+    if(lod.next_level){
+        result.next_level = texture_samplers_level(samplers, lod.next_level);
+        result.has_next_level = true;
+        result.t = lod.t;
+    }
+    return(result);
+}
+
+// NOTE: bilinear sample of one BitmapFormat_Linear16 or Linear16Block level, u/v in 0..1. Comes back premultiplied and linear.
+static RGBA
+sample_linear16(Bitmap* level, f32 u, f32 v){
+    // NOTE: texel centers, +0.5 keeps tx positive so truncating floors it. x/y end up
+    // one past the left/bottom texel of the 2x2, which the apron makes safe at u/v = 0.
+    f32 tx = (u * (f32)level->width) + 0.5f;
+    f32 ty = (v * (f32)level->height) + 0.5f;
+    s32 x = (s32)tx;
+    s32 y = (s32)ty;
+    f32 fx = tx - (f32)x;
+    f32 fy = ty - (f32)y;
+
+    assert(x >= 0 && x <= level->width);
+    assert(y >= 0 && y <= level->height);
+
+    // NOTE: x/y are also the apron coordinates of the left/bottom texel, which is what blocks are indexed by
+    u8* texel_ptr = 0;
+    s32 row_stride = 0;
+    if(level->format == BitmapFormat_Linear16Block){
+        texel_ptr = level->base + ((y / TEXEL_BLOCK_DIM) * level->stride) + ((x / TEXEL_BLOCK_DIM) * TEXEL_BLOCK_BYTES) +
+                    ((((y % TEXEL_BLOCK_DIM) * TEXEL_BLOCK_PITCH) + (x % TEXEL_BLOCK_DIM)) * (s32)sizeof(u64));
+        row_stride = TEXEL_BLOCK_PITCH * (s32)sizeof(u64);
+    }
+    else{
+        texel_ptr = level->base + ((y - 1) * level->stride) + ((x - 1) * (s32)sizeof(u64));
+        row_stride = level->stride;
+    }
+    RGBA texel_a = linear16_to_rgba(*(u64*)(texel_ptr));
+    RGBA texel_b = linear16_to_rgba(*(u64*)(texel_ptr + sizeof(u64)));
+    RGBA texel_c = linear16_to_rgba(*(u64*)(texel_ptr + row_stride));
+    RGBA texel_d = linear16_to_rgba(*(u64*)(texel_ptr + row_stride + sizeof(u64)));
+
+    RGBA result = lerp(lerp(texel_a, texel_b, fx), lerp(texel_c, texel_d, fx), fy);
+    return(result);
+}
+
+typedef struct TexelSample4x{
+    __m128 r, g, b, a;
+} TexelSample4x;
+
+// NOTE: sample_linear16() on 4 lanes, u/v have to be clamped to 0..1 even for masked lanes
+static inline TexelSample4x
+sample_linear16_4x(TextureSampler level, __m128 u, __m128 v){
+    __m128 one_4x = _mm_set1_ps(1.0f);
+    __m128 inv_65535_4x = _mm_set1_ps(1.0f / 65535.0f);
+    __m128 texel_offset_4x = _mm_set1_ps(0.5f);
+    bool block = level.block;
+    s32 stride = level.fetch_stride;
+
+    __m128 tx = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(level.width)), texel_offset_4x);
+    __m128 ty = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(level.height)), texel_offset_4x);
+    __m128i texel_x_4x = _mm_cvttps_epi32(tx);
+    __m128i texel_y_4x = _mm_cvttps_epi32(ty);
+    __m128 fx = _mm_sub_ps(tx, _mm_cvtepi32_ps(texel_x_4x));
+    __m128 fy = _mm_sub_ps(ty, _mm_cvtepi32_ps(texel_y_4x));
+
+    // select 4 texels for each lane, texel_x/y are one past the texel we want (apron)
+    s32 texel_x[4];
+    s32 texel_y[4];
+    _mm_storeu_si128((__m128i*)texel_x, texel_x_4x);
+    _mm_storeu_si128((__m128i*)texel_y, texel_y_4x);
+    u8* texel_ptr[4];
+    if(block){
+        for(s32 i=0; i < 4; ++i){
+            texel_ptr[i] = level.base + ((texel_y[i] / TEXEL_BLOCK_DIM) * level.level_stride) + ((texel_x[i] / TEXEL_BLOCK_DIM) * TEXEL_BLOCK_BYTES) +
+                           ((((texel_y[i] % TEXEL_BLOCK_DIM) * TEXEL_BLOCK_PITCH) + (texel_x[i] % TEXEL_BLOCK_DIM)) * (s32)sizeof(u64));
+        }
+    }
+    else{
+        for(s32 i=0; i < 4; ++i){
+            texel_ptr[i] = level.base + ((texel_y[i] - 1) * stride) + ((texel_x[i] - 1) * (s32)sizeof(u64));
         }
     }
+
+    TexelPair4x texel_ab = unpack_linear16_pairs_4x(_mm_loadu_si128((__m128i*)texel_ptr[0]), _mm_loadu_si128((__m128i*)texel_ptr[1]),
+                                                    _mm_loadu_si128((__m128i*)texel_ptr[2]), _mm_loadu_si128((__m128i*)texel_ptr[3]));
+    TexelPair4x texel_cd = unpack_linear16_pairs_4x(_mm_loadu_si128((__m128i*)(texel_ptr[0] + stride)), _mm_loadu_si128((__m128i*)(texel_ptr[1] + stride)),
+                                                    _mm_loadu_si128((__m128i*)(texel_ptr[2] + stride)), _mm_loadu_si128((__m128i*)(texel_ptr[3] + stride)));
+
+    // bilinear filtering
+#define LERP_4X(a, b, t) _mm_add_ps(_mm_mul_ps(_mm_sub_ps(one_4x, (t)), (a)), _mm_mul_ps((t), (b)))
+    TexelSample4x result;
+    result.r = _mm_mul_ps(LERP_4X(LERP_4X(texel_ab.left_r, texel_ab.right_r, fx), LERP_4X(texel_cd.left_r, texel_cd.right_r, fx), fy), inv_65535_4x);
+    result.g = _mm_mul_ps(LERP_4X(LERP_4X(texel_ab.left_g, texel_ab.right_g, fx), LERP_4X(texel_cd.left_g, texel_cd.right_g, fx), fy), inv_65535_4x);
+    result.b = _mm_mul_ps(LERP_4X(LERP_4X(texel_ab.left_b, texel_ab.right_b, fx), LERP_4X(texel_cd.left_b, texel_cd.right_b, fx), fy), inv_65535_4x);
+    result.a = _mm_mul_ps(LERP_4X(LERP_4X(texel_ab.left_a, texel_ab.right_a, fx), LERP_4X(texel_cd.left_a, texel_cd.right_a, fx), fy), inv_65535_4x);
+#undef LERP_4X
+    return(result);
 }
 
+// NOTE: the lod's level, blended with next_level when trilinear
+static inline TexelSample4x
+sample_lod_4x(SamplerLod lod, __m128 u, __m128 v){
+    TexelSample4x result = sample_linear16_4x(lod.level, u, v);
+    if(lod.has_next_level){
+        TexelSample4x next = sample_linear16_4x(lod.next_level, u, v);
+        __m128 t = _mm_set1_ps(lod.t);
+        result.r = _mm_add_ps(result.r, _mm_mul_ps(t, _mm_sub_ps(next.r, result.r)));
+        result.g = _mm_add_ps(result.g, _mm_mul_ps(t, _mm_sub_ps(next.g, result.g)));
+        result.b = _mm_add_ps(result.b, _mm_mul_ps(t, _mm_sub_ps(next.b, result.b)));
+        result.a = _mm_add_ps(result.a, _mm_mul_ps(t, _mm_sub_ps(next.a, result.a)));
+    }
+    return(result);
+}
+
+typedef struct TexelSample8x{
+    __m256 r, g, b, a;
+} TexelSample8x;
+
+TARGET_AVX2 static inline TexelSample8x
+sample_linear16_8x(TextureSampler level, __m256 u, __m256 v){
+    __m256 one_8x = _mm256_set1_ps(1.0f);
+    __m256 inv_65535_8x = _mm256_set1_ps(1.0f / 65535.0f);
+    __m256 texel_offset_8x = _mm256_set1_ps(0.5f);
+    bool block = level.block;
+    s32 stride = level.fetch_stride;
+
+    __m256 tx = _mm256_add_ps(_mm256_mul_ps(u, _mm256_set1_ps(level.width)), texel_offset_8x);
+    __m256 ty = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(level.height)), texel_offset_8x);
+    __m256i texel_x_8x = _mm256_cvttps_epi32(tx);
+    __m256i texel_y_8x = _mm256_cvttps_epi32(ty);
+    __m256 fx = _mm256_sub_ps(tx, _mm256_cvtepi32_ps(texel_x_8x));
+    __m256 fy = _mm256_sub_ps(ty, _mm256_cvtepi32_ps(texel_y_8x));
+
+    // select 4 texels for each lane, texel_x/y are one past the texel we want (apron)
+    __m256i offset_8x;
+    if(block){
+        // NOTE: TEXEL_BLOCK_DIM is 4, block index is >> 2 and the texel inside it is & 3
+        __m256i mask_3 = _mm256_set1_epi32(TEXEL_BLOCK_DIM - 1);
+        __m256i block_offset = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(texel_y_8x, 2), _mm256_set1_epi32(level.level_stride)),
+                                                _mm256_mullo_epi32(_mm256_srli_epi32(texel_x_8x, 2), _mm256_set1_epi32(TEXEL_BLOCK_BYTES)));
+        __m256i texel_index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(texel_y_8x, mask_3), _mm256_set1_epi32(TEXEL_BLOCK_PITCH)),
+                                               _mm256_and_si256(texel_x_8x, mask_3));
+        offset_8x = _mm256_add_epi32(block_offset, _mm256_slli_epi32(texel_index, 3));
+    }
+    else{
+        offset_8x = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(texel_y_8x, _mm256_set1_epi32(1)), _mm256_set1_epi32(stride)),
+                                     _mm256_slli_epi32(_mm256_sub_epi32(texel_x_8x, _mm256_set1_epi32(1)), 3));
+    }
+    s32 texel_offset[8];
+    _mm256_storeu_si256((__m256i*)texel_offset, offset_8x);
+    u8* texel_ptr[8];
+    for(s32 i=0; i < 8; ++i){
+        texel_ptr[i] = level.base + texel_offset[i];
+    }
+
+    TexelPair8x texel_ab = unpack_linear16_pairs_8x(load_texel_pair_8x(texel_ptr[0], texel_ptr[4]), load_texel_pair_8x(texel_ptr[1], texel_ptr[5]),
+                                                    load_texel_pair_8x(texel_ptr[2], texel_ptr[6]), load_texel_pair_8x(texel_ptr[3], texel_ptr[7]));
+    TexelPair8x texel_cd = unpack_linear16_pairs_8x(load_texel_pair_8x(texel_ptr[0] + stride, texel_ptr[4] + stride),
+                                                    load_texel_pair_8x(texel_ptr[1] + stride, texel_ptr[5] + stride),
+                                                    load_texel_pair_8x(texel_ptr[2] + stride, texel_ptr[6] + stride),
+                                                    load_texel_pair_8x(texel_ptr[3] + stride, texel_ptr[7] + stride));
+
+    // bilinear filtering
+#define LERP_8X(a, b, t) _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(one_8x, (t)), (a)), _mm256_mul_ps((t), (b)))
+    TexelSample8x result;
+    result.r = _mm256_mul_ps(LERP_8X(LERP_8X(texel_ab.left_r, texel_ab.right_r, fx), LERP_8X(texel_cd.left_r, texel_cd.right_r, fx), fy), inv_65535_8x);
+    result.g = _mm256_mul_ps(LERP_8X(LERP_8X(texel_ab.left_g, texel_ab.right_g, fx), LERP_8X(texel_cd.left_g, texel_cd.right_g, fx), fy), inv_65535_8x);
+    result.b = _mm256_mul_ps(LERP_8X(LERP_8X(texel_ab.left_b, texel_ab.right_b, fx), LERP_8X(texel_cd.left_b, texel_cd.right_b, fx), fy), inv_65535_8x);
+    result.a = _mm256_mul_ps(LERP_8X(LERP_8X(texel_ab.left_a, texel_ab.right_a, fx), LERP_8X(texel_cd.left_a, texel_cd.right_a, fx), fy), inv_65535_8x);
+#undef LERP_8X
+    return(result);
+}
+
+TARGET_AVX2 static inline TexelSample8x
+sample_lod_8x(SamplerLod lod, __m256 u, __m256 v){
+    TexelSample8x result = sample_linear16_8x(lod.level, u, v);
+    if(lod.has_next_level){
+        TexelSample8x next = sample_linear16_8x(lod.next_level, u, v);
+        __m256 t = _mm256_set1_ps(lod.t);
+        result.r = _mm256_add_ps(result.r, _mm256_mul_ps(t, _mm256_sub_ps(next.r, result.r)));
+        result.g = _mm256_add_ps(result.g, _mm256_mul_ps(t, _mm256_sub_ps(next.g, result.g)));
+        result.b = _mm256_add_ps(result.b, _mm256_mul_ps(t, _mm256_sub_ps(next.b, result.b)));
+        result.a = _mm256_add_ps(result.a, _mm256_mul_ps(t, _mm256_sub_ps(next.a, result.a)));
+    }
+    return(result);
+}
 
 static void
-draw_bitmap_slow(RenderBuffer *render_buffer, v2 origin, v2 x_axis, v2 y_axis, Bitmap* texture, RGBA color = {0, 0, 0, 1}){
+draw_bitmap_slow(RenderBuffer *render_buffer, RectS32 clip, v2 origin, v2 x_axis, v2 y_axis, Bitmap* texture, bool trilinear, RGBA color = {0, 0, 0, 1}){
 
     // pre-multiply alpha for color
     color.rgb *= color.a;
 
     f32 inv_xaxis_mag_sqrt = 1.0f / magnitude_sqrt_v2(x_axis);
     f32 inv_yaxis_mag_sqrt = 1.0f / magnitude_sqrt_v2(y_axis);
+    TextureLod lod = select_texture_lod(texture, x_axis, y_axis, trilinear);
 
-    s32 max_width = render_buffer->width - 1;
-    s32 max_height = render_buffer->height - 1;
-    s32 xmax = 0;
-    s32 xmin = max_width;
-    s32 ymax = 0;
-    s32 ymin = max_height;
+    s32 xmax = clip.x0;
+    s32 xmin = clip.x1;
+    s32 ymax = clip.y0;
+    s32 ymin = clip.y1;
 
     v2 points[4] = {origin, origin + x_axis, origin + y_axis, origin + x_axis + y_axis};
     for(u32 i=0; i < array_count(points); ++i){
@@ -661,21 +1952,22 @@ draw_bitmap_slow(RenderBuffer *render_buffer, v2 origin, v2 x_axis, v2 y_axis, B
 
         if(x < xmin){ xmin = x; }
         if(y < ymin){ ymin = y; }
-        if(x > xmax){ xmax = x; }
+        if(x + 1 > xmax){ xmax = x + 1; }
         if(y > ymax){ ymax = y; }
     }
 
-    if(xmin < 0){ xmin = 0; }
-    if(ymin < 0){ ymin = 0; }
-    if(xmax > max_width){ xmax = max_width; }
-    if(ymax > max_height){ ymax = max_height; }
+    // NOTE: xmax/ymax are exclusive, clamp them to the clip rect
+    if(xmin < clip.x0){ xmin = clip.x0; }
+    if(ymin < clip.y0){ ymin = clip.y0; }
+    if(xmax > clip.x1){ xmax = clip.x1; }
+    if(ymax > clip.y1){ ymax = clip.y1; }
 
     u8 *row = (u8 *)render_buffer->base +
                (ymin * render_buffer->stride) +
                (xmin * render_buffer->bytes_per_pixel);
     for(s32 y=ymin; y < ymax; ++y){
         u32* pixel = (u32*)row;
-        for(s32 x=xmin; x <= xmax; ++x){
+        for(s32 x=xmin; x < xmax; ++x){
 
             v2 pixel_pos = {(f32)x, (f32)y};
             v2 dist = pixel_pos - origin;
@@ -692,39 +1984,11 @@ draw_bitmap_slow(RenderBuffer *render_buffer, v2 origin, v2 x_axis, v2 y_axis, B
                 assert(u >= 0.0f && u <= 1.0f);
                 assert(v >= 0.0f && v <= 1.0f);
 
-                //f32 tx = ((u * (f32)(texture->width  - 1)) + 0.5f);
-                //f32 ty = ((v * (f32)(texture->height - 1)) + 0.5f);
-                f32 tx = 1.0f + ((u * (f32)(texture->width  - 3)) + 0.5f);
-                f32 ty = 1.0f + ((v * (f32)(texture->height - 3)) + 0.5f);
-                s32 x = (s32)tx;
-                s32 y = (s32)ty;
-                f32 fx = tx - (f32)x;
-                f32 fy = ty - (f32)y;
-
-                assert(x >= 0 && x < texture->width);
-                assert(y >= 0 && y < texture->height);
-
-                // select 4 pixels
-                u8* texel_ptr = ((u8*)texture->base + (y * texture->stride) + (x * 4));
-                u32* texel_ptr_a = (u32*)(texel_ptr);
-                u32* texel_ptr_b = (u32*)(texel_ptr + sizeof(u32));
-                u32* texel_ptr_c = (u32*)(texel_ptr + texture->stride);
-                u32* texel_ptr_d = (u32*)(texel_ptr + texture->stride + sizeof(u32));
-
-                // convert to RGBA normalized
-                RGBA texel_a = u32_to_rgba_normal(*texel_ptr_a);
-                RGBA texel_b = u32_to_rgba_normal(*texel_ptr_b);
-                RGBA texel_c = u32_to_rgba_normal(*texel_ptr_c);
-                RGBA texel_d = u32_to_rgba_normal(*texel_ptr_d);
-
-                // convert to linear space
-                texel_a = srgb_to_linear(texel_a);
-                texel_b = srgb_to_linear(texel_b);
-                texel_c = srgb_to_linear(texel_c);
-                texel_d = srgb_to_linear(texel_d);
-
-                // bilinear filtering
-                RGBA texel = lerp(lerp(texel_a, texel_b, fx), lerp(texel_c, texel_d, fx), fy);
+                // bilinear filtering, texels are already premultiplied and linear
+                RGBA texel = sample_linear16(lod.level, u, v);
+                if(lod.next_level){
+                    texel = lerp(texel, sample_linear16(lod.next_level, u, v), lod.t);
+                }
                 RGBA pixel_color = u32_to_rgba_normal(*pixel);
                 pixel_color = srgb_to_linear(pixel_color);
 
@@ -757,126 +2021,357 @@ draw_bitmap_slow(RenderBuffer *render_buffer, v2 origin, v2 x_axis, v2 y_axis, B
     }
 }
 
+// NOTE: Wide versions of draw_bitmap_slow. draw_bitmap_slow stays the reference,
+// these have to match it per pixel (give or take rounding on the final *255).
+// Lanes outside the basis or past the end of the row are masked, and we never
+// write outside of the clip rect.
+static void
+draw_basis_quad_4x(RenderBuffer *render_buffer, RectS32 clip, v2 origin, v2 x_axis, v2 y_axis, SamplerLod lod){
+    f32 inv_xaxis_mag_sqrt = 1.0f / magnitude_sqrt_v2(x_axis);
+    f32 inv_yaxis_mag_sqrt = 1.0f / magnitude_sqrt_v2(y_axis);
+
+    s32 xmax = clip.x0;
+    s32 xmin = clip.x1;
+    s32 ymax = clip.y0;
+    s32 ymin = clip.y1;
+
+    v2 points[4] = {origin, origin + x_axis, origin + y_axis, origin + x_axis + y_axis};
+    for(u32 i=0; i < array_count(points); ++i){
+        v2 test_p = points[i];
+        s32 x = round_f32_s32(test_p.x);
+        s32 y = round_f32_s32(test_p.y);
+
+        if(x < xmin){ xmin = x; }
+        if(y < ymin){ ymin = y; }
+        if(x + 1 > xmax){ xmax = x + 1; }
+        if(y > ymax){ ymax = y; }
+    }
+
+    if(xmin < clip.x0){ xmin = clip.x0; }
+    if(ymin < clip.y0){ ymin = clip.y0; }
+    if(xmax > clip.x1){ xmax = clip.x1; }
+    if(ymax > clip.y1){ ymax = clip.y1; }
+
+    __m128 zero_4x = _mm_set1_ps(0.0f);
+    __m128 one_4x = _mm_set1_ps(1.0f);
+    __m128 inv_255_4x = _mm_set1_ps(1.0f / 255.0f);
+    __m128 color_255_4x = _mm_set1_ps(255.0f);
+    __m128i mask_FF = _mm_set1_epi32(0xFF);
+
+    __m128 origin_x_4x = _mm_set1_ps(origin.x);
+    __m128 origin_y_4x = _mm_set1_ps(origin.y);
+    __m128 x_axis_x_4x = _mm_set1_ps(x_axis.x);
+    __m128 x_axis_y_4x = _mm_set1_ps(x_axis.y);
+    __m128 y_axis_x_4x = _mm_set1_ps(y_axis.x);
+    __m128 y_axis_y_4x = _mm_set1_ps(y_axis.y);
+    __m128 inv_xaxis_mag_sqrt_4x = _mm_set1_ps(inv_xaxis_mag_sqrt);
+    __m128 inv_yaxis_mag_sqrt_4x = _mm_set1_ps(inv_yaxis_mag_sqrt);
+    __m128i lane_4x = _mm_setr_epi32(0, 1, 2, 3);
+
+    u8 *row = (u8 *)render_buffer->base + (ymin * render_buffer->stride);
+    for(s32 y=ymin; y < ymax; ++y){
+        __m128 pixel_y_4x = _mm_set1_ps((f32)y);
+        __m128 dist_y_4x = _mm_sub_ps(pixel_y_4x, origin_y_4x);
+
+        for(s32 x=xmin; x < xmax; x += 4){
+            s32 chunk_x = x;
+            __m128i tail_mask = _mm_set1_epi32(-1);
+            u32* pixel = (u32*)row + chunk_x;
+            u32 narrow[4];
+            s32 narrow_count = 0;
+            if(chunk_x + 4 > xmax){
+                if(xmax - xmin < 4){
+                    // NOTE: row is narrower than a chunk. Run it on a copy so the lanes past xmax never
+                    // touch the buffer (another tile can own those pixels), with the same math as every
+                    // other chunk so tiled and untiled output match.
+                    narrow_count = xmax - x;
+                    for(s32 i=0; i < 4; ++i){
+                        narrow[i] = (i < narrow_count) ? pixel[i] : 0;
+                    }
+                    pixel = narrow;
+                    tail_mask = _mm_cmpgt_epi32(_mm_set1_epi32(narrow_count), lane_4x);
+                }
+                else{
+                    // NOTE: step back so the chunk ends on xmax, and mask out what we already did
+                    chunk_x = xmax - 4;
+                    pixel = (u32*)row + chunk_x;
+                    tail_mask = _mm_cmpgt_epi32(_mm_add_epi32(_mm_set1_epi32(chunk_x), lane_4x), _mm_set1_epi32(x - 1));
+                }
+            }
+
+            __m128 pixel_x_4x = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(chunk_x), lane_4x));
+            __m128 dist_x_4x = _mm_sub_ps(pixel_x_4x, origin_x_4x);
+
+            // edge tests
+            __m128 edge0 = _mm_sub_ps(_mm_mul_ps(dist_x_4x, x_axis_y_4x), _mm_mul_ps(dist_y_4x, x_axis_x_4x));
+            __m128 edge1 = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(dist_x_4x, x_axis_x_4x), y_axis_y_4x),
+                                      _mm_mul_ps(_mm_sub_ps(dist_y_4x, x_axis_y_4x), y_axis_x_4x));
+            __m128 edge2 = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(_mm_sub_ps(dist_y_4x, x_axis_y_4x), y_axis_y_4x), x_axis_x_4x),
+                                      _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(dist_x_4x, x_axis_x_4x), y_axis_x_4x), x_axis_y_4x));
+            __m128 edge3 = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(dist_y_4x, y_axis_y_4x), y_axis_x_4x),
+                                      _mm_mul_ps(_mm_sub_ps(dist_x_4x, y_axis_x_4x), y_axis_y_4x));
+
+            __m128i write_mask = _mm_castps_si128(_mm_and_ps(_mm_and_ps(_mm_cmplt_ps(edge0, zero_4x), _mm_cmplt_ps(edge1, zero_4x)),
+                                                             _mm_and_ps(_mm_cmplt_ps(edge2, zero_4x), _mm_cmplt_ps(edge3, zero_4x))));
+            write_mask = _mm_and_si128(write_mask, tail_mask);
+            if(_mm_movemask_epi8(write_mask)){
+                // get UV coordinates, clamped so masked lanes still fetch inside the texture
+                __m128 u = _mm_mul_ps(inv_xaxis_mag_sqrt_4x, _mm_add_ps(_mm_mul_ps(dist_x_4x, x_axis_x_4x), _mm_mul_ps(dist_y_4x, x_axis_y_4x)));
+                __m128 v = _mm_mul_ps(inv_yaxis_mag_sqrt_4x, _mm_add_ps(_mm_mul_ps(dist_x_4x, y_axis_x_4x), _mm_mul_ps(dist_y_4x, y_axis_y_4x)));
+                u = _mm_min_ps(_mm_max_ps(u, zero_4x), one_4x);
+                v = _mm_min_ps(_mm_max_ps(v, zero_4x), one_4x);
+
+                // texels are already premultiplied and linear
+                TexelSample4x texel = sample_lod_4x(lod, u, v);
+
+                // convert dest to RGBA normalized, and to linear space
+#define UNPACK_4X(value, shift) _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32((value), (shift)), mask_FF)), inv_255_4x)
+#define UNPACK_LINEAR_4X(value, shift) _mm_mul_ps(UNPACK_4X(value, shift), UNPACK_4X(value, shift))
+
+                __m128i loaded_pixel_4x = _mm_loadu_si128((__m128i*)pixel);
+                __m128 dest_r = UNPACK_LINEAR_4X(loaded_pixel_4x, 16);
+                __m128 dest_g = UNPACK_LINEAR_4X(loaded_pixel_4x, 8);
+                __m128 dest_b = UNPACK_LINEAR_4X(loaded_pixel_4x, 0);
+                __m128 dest_a = UNPACK_4X(loaded_pixel_4x, 24);
+#undef UNPACK_LINEAR_4X
+#undef UNPACK_4X
+
+                // linear blend
+                __m128 inv_texel_a = _mm_sub_ps(one_4x, texel.a);
+                __m128 write_r = _mm_add_ps(_mm_mul_ps(inv_texel_a, dest_r), texel.r);
+                __m128 write_g = _mm_add_ps(_mm_mul_ps(inv_texel_a, dest_g), texel.g);
+                __m128 write_b = _mm_add_ps(_mm_mul_ps(inv_texel_a, dest_b), texel.b);
+                __m128 write_a = _mm_add_ps(_mm_mul_ps(inv_texel_a, dest_a), texel.a);
+
+                // convert to SRGB space, cvtps rounds to nearest
+                __m128i int_r = _mm_cvtps_epi32(_mm_mul_ps(_mm_sqrt_ps(write_r), color_255_4x));
+                __m128i int_g = _mm_cvtps_epi32(_mm_mul_ps(_mm_sqrt_ps(write_g), color_255_4x));
+                __m128i int_b = _mm_cvtps_epi32(_mm_mul_ps(_mm_sqrt_ps(write_b), color_255_4x));
+                __m128i int_a = _mm_cvtps_epi32(_mm_mul_ps(write_a, color_255_4x));
+
+                __m128i output_pixel_4x = _mm_or_si128(_mm_slli_epi32(int_a, 24),
+                                          _mm_or_si128(_mm_slli_epi32(int_r, 16),
+                                          _mm_or_si128(_mm_slli_epi32(int_g, 8), int_b)));
+
+                // write color
+                __m128i masked_out = _mm_or_si128(_mm_and_si128(write_mask, output_pixel_4x),
+                                                  _mm_andnot_si128(write_mask, loaded_pixel_4x));
+                _mm_storeu_si128((__m128i*)pixel, masked_out);
+            }
+            if(narrow_count){
+                u32* dest = (u32*)row + chunk_x;
+                for(s32 i=0; i < narrow_count; ++i){
+                    dest[i] = narrow[i];
+                }
+            }
+        }
+        row += render_buffer->stride;
+    }
+}
+
+TARGET_AVX2 static void
+draw_basis_quad_8x(RenderBuffer *render_buffer, RectS32 clip, v2 origin, v2 x_axis, v2 y_axis, SamplerLod lod){
+    f32 inv_xaxis_mag_sqrt = 1.0f / magnitude_sqrt_v2(x_axis);
+    f32 inv_yaxis_mag_sqrt = 1.0f / magnitude_sqrt_v2(y_axis);
+
+    s32 xmax = clip.x0;
+    s32 xmin = clip.x1;
+    s32 ymax = clip.y0;
+    s32 ymin = clip.y1;
+
+    v2 points[4] = {origin, origin + x_axis, origin + y_axis, origin + x_axis + y_axis};
+    for(u32 i=0; i < array_count(points); ++i){
+        v2 test_p = points[i];
+        s32 x = round_f32_s32(test_p.x);
+        s32 y = round_f32_s32(test_p.y);
+
+        if(x < xmin){ xmin = x; }
+        if(y < ymin){ ymin = y; }
+        if(x + 1 > xmax){ xmax = x + 1; }
+        if(y > ymax){ ymax = y; }
+    }
+
+    if(xmin < clip.x0){ xmin = clip.x0; }
+    if(ymin < clip.y0){ ymin = clip.y0; }
+    if(xmax > clip.x1){ xmax = clip.x1; }
+    if(ymax > clip.y1){ ymax = clip.y1; }
+
+    __m256 zero_8x = _mm256_set1_ps(0.0f);
+    __m256 one_8x = _mm256_set1_ps(1.0f);
+    __m256 inv_255_8x = _mm256_set1_ps(1.0f / 255.0f);
+    __m256 color_255_8x = _mm256_set1_ps(255.0f);
+    __m256i mask_FF = _mm256_set1_epi32(0xFF);
+
+    __m256 origin_x_8x = _mm256_set1_ps(origin.x);
+    __m256 origin_y_8x = _mm256_set1_ps(origin.y);
+    __m256 x_axis_x_8x = _mm256_set1_ps(x_axis.x);
+    __m256 x_axis_y_8x = _mm256_set1_ps(x_axis.y);
+    __m256 y_axis_x_8x = _mm256_set1_ps(y_axis.x);
+    __m256 y_axis_y_8x = _mm256_set1_ps(y_axis.y);
+    __m256 inv_xaxis_mag_sqrt_8x = _mm256_set1_ps(inv_xaxis_mag_sqrt);
+    __m256 inv_yaxis_mag_sqrt_8x = _mm256_set1_ps(inv_yaxis_mag_sqrt);
+    __m256i lane_8x = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    u8 *row = (u8 *)render_buffer->base + (ymin * render_buffer->stride);
+    for(s32 y=ymin; y < ymax; ++y){
+        __m256 pixel_y_8x = _mm256_set1_ps((f32)y);
+        __m256 dist_y_8x = _mm256_sub_ps(pixel_y_8x, origin_y_8x);
+
+        for(s32 x=xmin; x < xmax; x += 8){
+            s32 chunk_x = x;
+            __m256i tail_mask = _mm256_set1_epi32(-1);
+            u32* pixel = (u32*)row + chunk_x;
+            u32 narrow[8];
+            s32 narrow_count = 0;
+            if(chunk_x + 8 > xmax){
+                if(xmax - xmin < 8){
+                    // NOTE: row is narrower than a chunk. Run it on a copy so the lanes past xmax never
+                    // touch the buffer (another tile can own those pixels), with the same math as every
+                    // other chunk so tiled and untiled output match.
+                    narrow_count = xmax - x;
+                    for(s32 i=0; i < 8; ++i){
+                        narrow[i] = (i < narrow_count) ? pixel[i] : 0;
+                    }
+                    pixel = narrow;
+                    tail_mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(narrow_count), lane_8x);
+                }
+                else{
+                    // NOTE: step back so the chunk ends on xmax, and mask out what we already did
+                    chunk_x = xmax - 8;
+                    pixel = (u32*)row + chunk_x;
+                    tail_mask = _mm256_cmpgt_epi32(_mm256_add_epi32(_mm256_set1_epi32(chunk_x), lane_8x), _mm256_set1_epi32(x - 1));
+                }
+            }
+
+            __m256 pixel_x_8x = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(chunk_x), lane_8x));
+            __m256 dist_x_8x = _mm256_sub_ps(pixel_x_8x, origin_x_8x);
+
+            // edge tests
+            __m256 edge0 = _mm256_sub_ps(_mm256_mul_ps(dist_x_8x, x_axis_y_8x), _mm256_mul_ps(dist_y_8x, x_axis_x_8x));
+            __m256 edge1 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(dist_x_8x, x_axis_x_8x), y_axis_y_8x),
+                                         _mm256_mul_ps(_mm256_sub_ps(dist_y_8x, x_axis_y_8x), y_axis_x_8x));
+            __m256 edge2 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(dist_y_8x, x_axis_y_8x), y_axis_y_8x), x_axis_x_8x),
+                                         _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(dist_x_8x, x_axis_x_8x), y_axis_x_8x), x_axis_y_8x));
+            __m256 edge3 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(dist_y_8x, y_axis_y_8x), y_axis_x_8x),
+                                         _mm256_mul_ps(_mm256_sub_ps(dist_x_8x, y_axis_x_8x), y_axis_y_8x));
+
+            __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(edge0, zero_8x, _CMP_LT_OQ), _mm256_cmp_ps(edge1, zero_8x, _CMP_LT_OQ)),
+                                          _mm256_and_ps(_mm256_cmp_ps(edge2, zero_8x, _CMP_LT_OQ), _mm256_cmp_ps(edge3, zero_8x, _CMP_LT_OQ)));
+            __m256i write_mask = _mm256_and_si256(_mm256_castps_si256(inside), tail_mask);
+            if(!_mm256_testz_si256(write_mask, write_mask)){
+                // get UV coordinates, clamped so masked lanes still fetch inside the texture
+                __m256 u = _mm256_mul_ps(inv_xaxis_mag_sqrt_8x, _mm256_add_ps(_mm256_mul_ps(dist_x_8x, x_axis_x_8x), _mm256_mul_ps(dist_y_8x, x_axis_y_8x)));
+                __m256 v = _mm256_mul_ps(inv_yaxis_mag_sqrt_8x, _mm256_add_ps(_mm256_mul_ps(dist_x_8x, y_axis_x_8x), _mm256_mul_ps(dist_y_8x, y_axis_y_8x)));
+                u = _mm256_min_ps(_mm256_max_ps(u, zero_8x), one_8x);
+                v = _mm256_min_ps(_mm256_max_ps(v, zero_8x), one_8x);
+
+                // texels are already premultiplied and linear
+                TexelSample8x texel = sample_lod_8x(lod, u, v);
+
+                // convert dest to RGBA normalized, and to linear space
+#define UNPACK_8X(value, shift) _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32((value), (shift)), mask_FF)), inv_255_8x)
+#define UNPACK_LINEAR_8X(value, shift) _mm256_mul_ps(UNPACK_8X(value, shift), UNPACK_8X(value, shift))
+
+                __m256i loaded_pixel_8x = _mm256_loadu_si256((__m256i*)pixel);
+                __m256 dest_r = UNPACK_LINEAR_8X(loaded_pixel_8x, 16);
+                __m256 dest_g = UNPACK_LINEAR_8X(loaded_pixel_8x, 8);
+                __m256 dest_b = UNPACK_LINEAR_8X(loaded_pixel_8x, 0);
+                __m256 dest_a = UNPACK_8X(loaded_pixel_8x, 24);
+#undef UNPACK_LINEAR_8X
+#undef UNPACK_8X
+
+                // linear blend
+                __m256 inv_texel_a = _mm256_sub_ps(one_8x, texel.a);
+                __m256 write_r = _mm256_add_ps(_mm256_mul_ps(inv_texel_a, dest_r), texel.r);
+                __m256 write_g = _mm256_add_ps(_mm256_mul_ps(inv_texel_a, dest_g), texel.g);
+                __m256 write_b = _mm256_add_ps(_mm256_mul_ps(inv_texel_a, dest_b), texel.b);
+                __m256 write_a = _mm256_add_ps(_mm256_mul_ps(inv_texel_a, dest_a), texel.a);
+
+                // convert to SRGB space, cvtps rounds to nearest
+                __m256i int_r = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_sqrt_ps(write_r), color_255_8x));
+                __m256i int_g = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_sqrt_ps(write_g), color_255_8x));
+                __m256i int_b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_sqrt_ps(write_b), color_255_8x));
+                __m256i int_a = _mm256_cvtps_epi32(_mm256_mul_ps(write_a, color_255_8x));
+
+                __m256i output_pixel_8x = _mm256_or_si256(_mm256_slli_epi32(int_a, 24),
+                                          _mm256_or_si256(_mm256_slli_epi32(int_r, 16),
+                                          _mm256_or_si256(_mm256_slli_epi32(int_g, 8), int_b)));
+
+                // write color
+                __m256i masked_out = _mm256_blendv_epi8(loaded_pixel_8x, output_pixel_8x, write_mask);
+                _mm256_storeu_si256((__m256i*)pixel, masked_out);
+            }
+            if(narrow_count){
+                u32* dest = (u32*)row + chunk_x;
+                for(s32 i=0; i < narrow_count; ++i){
+                    dest[i] = narrow[i];
+                }
+            }
+        }
+        row += render_buffer->stride;
+    }
+}
+
 static void
-draw_rect(RenderBuffer *render_buffer, Rect rect, RGBA color){
+draw_bitmap_4x(RenderBuffer *render_buffer, RectS32 clip, v2 origin, v2 x_axis, v2 y_axis, Bitmap* texture, bool trilinear){
+    TextureLod lod = select_texture_lod(texture, x_axis, y_axis, trilinear);
+    draw_basis_quad_4x(render_buffer, clip, origin, x_axis, y_axis, make_sampler_lod(lod));
+}
+
+TARGET_AVX2 static void
+draw_bitmap_8x(RenderBuffer *render_buffer, RectS32 clip, v2 origin, v2 x_axis, v2 y_axis, Bitmap* texture, bool trilinear){
+    TextureLod lod = select_texture_lod(texture, x_axis, y_axis, trilinear);
+    draw_basis_quad_8x(render_buffer, clip, origin, x_axis, y_axis, make_sampler_lod(lod));
+}
+
+// NOTE: picks the widest draw_bitmap path this cpu supports
+static void
+draw_bitmap_basis(RenderBuffer *render_buffer, RectS32 clip, v2 origin, v2 x_axis, v2 y_axis, Bitmap* texture, bool trilinear){
+    assert(cpu_features.detected);
+    assert(texture->format == BitmapFormat_Linear16 || texture->format == BitmapFormat_Linear16Block);
+    if(cpu_features.avx2){
+        draw_bitmap_8x(render_buffer, clip, origin, x_axis, y_axis, texture, trilinear);
+    }
+    else if(cpu_features.sse2){
+        draw_bitmap_4x(render_buffer, clip, origin, x_axis, y_axis, texture, trilinear);
+    }
+    else{
+        draw_bitmap_slow(render_buffer, clip, origin, x_axis, y_axis, texture, trilinear);
+    }
+}
+
+static void
+draw_rect(RenderBuffer *render_buffer, RectS32 clip, Rect rect, RGBA color){
     // round min/max
     v2s32 pixel_min = round_v2_v2s32(rect.min);
     v2s32 pixel_max = round_v2_v2s32(rect.max);
 
-    // clamp min/max of rect to render_buffer
-    if(pixel_min.x < 0) { pixel_min.x = 0; }
-    if(pixel_min.y < 0) { pixel_min.y = 0; }
-    if(pixel_max.x > render_buffer->width) { pixel_max.x = render_buffer->width; }
-    if(pixel_max.y > render_buffer->height) { pixel_max.y = render_buffer->height; }
-
-    // helper 4x variables
-    __m128i max_x_4x = _mm_set1_epi32(pixel_max.x);
-    __m128 color_255_4x = _mm_set_ps1(255.0f);
-    __m128 color_one_4x = _mm_set_ps1(1.0f);
-    __m128 color_zero_4x = _mm_set_ps1(0.0f);
-    __m128 mask_FF = _mm_set1_epi32(0xFF);
-
-    // 4x of input color
-    __m128 color_a_4x = _mm_set_ps1(color.a);
-    __m128 color_r_4x = _mm_set_ps1(color.r);
-    __m128 color_g_4x = _mm_set_ps1(color.g);
-    __m128 color_b_4x = _mm_set_ps1(color.b);
-
-    // pre multiply alphas for current
-    __m128 current_a_percent_4x = _mm_sub_ps(color_one_4x, color_a_4x);
-    __m128 scaled_color_r_4x = _mm_mul_ps(color_r_4x, color_255_4x);
-    __m128 scaled_color_g_4x = _mm_mul_ps(color_g_4x, color_255_4x);
-    __m128 scaled_color_b_4x = _mm_mul_ps(color_b_4x, color_255_4x);
-
-    // pre multiply alphas for input color
-    __m128 new_color_r_4x = (color_a_4x * scaled_color_r_4x);
-    __m128 new_color_g_4x = (color_a_4x * scaled_color_g_4x);
-    __m128 new_color_b_4x = (color_a_4x * scaled_color_b_4x);
-
-    // compute initial increment
-    s32 width = pixel_max.x - pixel_min.x;
-    s32 remainder = width % 4;
-    s32 increment = remainder ? remainder : 4;
-
-    // compute mask
-    __m128i mask = _mm_setr_epi32(-(increment > 0), -(increment > 1), -(increment > 2), -(increment > 3));
-    __m128i ones_mask = _mm_cmpeq_epi32(mask, mask);
+    // clamp min/max of rect to clip rect
+    if(pixel_min.x < clip.x0) { pixel_min.x = clip.x0; }
+    if(pixel_min.y < clip.y0) { pixel_min.y = clip.y0; }
+    if(pixel_max.x > clip.x1) { pixel_max.x = clip.x1; }
+    if(pixel_max.y > clip.y1) { pixel_max.y = clip.y1; }
+    if(pixel_min.x >= pixel_max.x){
+        return;
+    }
+
+    u32 packed_color = rgba_to_u32(color);
 
     // get row based of clamped pixel_min.x/pixel_min.y
     u8 *row = (u8 *)render_buffer->base +
               (pixel_min.y * render_buffer->stride) +
               (pixel_min.x * render_buffer->bytes_per_pixel);
 
-    // iterate over clamped pixel_min.x/pixel_min.y
-    //BEGIN_CYCLE_COUNTER(draw_rect_fast)
+    // NOTE: never touch a pixel outside of the clip rect, other threads may own it.
     for(s32 y=pixel_min.y; y < pixel_max.y; ++y){
-        u32* pixel = (u32*)row;
-
-        for(s32 x=pixel_min.x; x < pixel_max.x; ){
-            // if x in dead zone, load last 4 pixels and set mask appropriately
-            if(x > render_buffer->width - 4){
-                row = (u8 *)render_buffer->base +
-                      ((render_buffer->height - 1 - pixel_min.y) * render_buffer->stride) +
-                      ((render_buffer->width - 4) * render_buffer->bytes_per_pixel);
-                pixel = (u32*)row;
-                mask = ~mask;
-            }
-
-            __m128i loaded_pixel_4x = _mm_loadu_si128((__m128i*)pixel);
-
-            // from: argb-argb-argb-argb
-            // to:   aaaa-rrrr-gggg-bbbb
-            __m128 loaded_r_4x = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(loaded_pixel_4x, 16), mask_FF));
-            __m128 loaded_g_4x = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(loaded_pixel_4x, 8),  mask_FF));
-            __m128 loaded_b_4x = _mm_cvtepi32_ps(_mm_and_si128(loaded_pixel_4x, mask_FF));
-
-            // linear blend between loaded color and input color
-            __m128 new_loaded_r_4x = _mm_mul_ps(current_a_percent_4x, loaded_r_4x);
-            __m128 new_loaded_g_4x = _mm_mul_ps(current_a_percent_4x, loaded_g_4x);
-            __m128 new_loaded_b_4x = _mm_mul_ps(current_a_percent_4x, loaded_b_4x);
-
-            __m128 new_r_4x = _mm_add_ps(new_loaded_r_4x, new_color_r_4x);
-            __m128 new_g_4x = _mm_add_ps(new_loaded_g_4x, new_color_g_4x);
-            __m128 new_b_4x = _mm_add_ps(new_loaded_b_4x, new_color_b_4x);
-            __m128 new_a_4x = _mm_mul_ps(color_a_4x, color_255_4x);
-
-            // convert to int, cvtps rounds to nearest. no need for +0.5f
-            __m128i int_a_4x = _mm_cvtps_epi32(new_a_4x);
-            __m128i int_r_4x = _mm_cvtps_epi32(new_r_4x);
-            __m128i int_g_4x = _mm_cvtps_epi32(new_g_4x);
-            __m128i int_b_4x = _mm_cvtps_epi32(new_b_4x);
-
-            // shift argb order
-            __m128i shifted_int_a_4x = _mm_slli_epi32(int_a_4x, 24);
-            __m128i shifted_int_r_4x = _mm_slli_epi32(int_r_4x, 16);
-            __m128i shifted_int_g_4x = _mm_slli_epi32(int_g_4x, 8);
-            __m128i shifted_int_b_4x = int_b_4x;
-
-            // or everything together
-            __m128i output_pixel_4x = _mm_or_si128(shifted_int_a_4x,
-                                      _mm_or_si128(shifted_int_r_4x,
-                                      _mm_or_si128(shifted_int_g_4x,
-                                                   shifted_int_b_4x)));
-
-            __m128i output_masked = _mm_and_si128(mask, output_pixel_4x);
-
-            _mm_storeu_si128((__m128i * )pixel, output_masked);
-
-            pixel += increment;
-            x+=increment;
-            increment = 4;
-            mask = ones_mask;
-        }
-        increment = remainder ? remainder : 4;
-        mask = _mm_setr_epi32(-(increment > 0), -(increment > 1), -(increment > 2), -(increment > 3));
+        fill_span((u32*)row, pixel_max.x - pixel_min.x, packed_color);
         row += render_buffer->stride;
     }
-    //END_CYCLE_COUNTER(draw_rect_fast)
 }
 
 // UNTESTED: untested with rect screenspace change
 static void
-draw_box(RenderBuffer *render_buffer, Rect rect, RGBA color){
+draw_box(RenderBuffer *render_buffer, RectS32 clip, Rect rect, RGBA color){
     //RectPixelSpace rect_ps = screen_to_pixel(rect, resolution);
 
     v2 p0 = rect.min;
@@ -884,169 +2379,778 @@ draw_box(RenderBuffer *render_buffer, Rect rect, RGBA color){
     v2 p2 = rect.max;
     v2 p3 = {rect.min.x, rect.max.y};
 
-    draw_segment(render_buffer, p0, p1, color);
-    draw_segment(render_buffer, p1, p2, color);
-    draw_segment(render_buffer, p2, p3, color);
-    draw_segment(render_buffer, p3, p0, color);
+    draw_segment(render_buffer, clip, p0, p1, color);
+    draw_segment(render_buffer, clip, p1, p2, color);
+    draw_segment(render_buffer, clip, p2, p3, color);
+    draw_segment(render_buffer, clip, p3, p0, color);
 }
 
-static void
-draw_quad(RenderBuffer *render_buffer, v2 p0_, v2 p1_, v2 p2_, v2 p3_, RGBA color, bool fill){
-    v2 p0 = p0_;
-    v2 p1 = p1_;
-    v2 p2 = p2_;
-    v2 p3 = p3_;
-
-    if(p0.x > p1.x){ swap_v2(&p0, &p1); }
-    if(p0.x > p2.x){ swap_v2(&p0, &p2); }
-    if(p0.y > p2.y){ swap_v2(&p0, &p2); }
-    if(p0.x > p3.x){ swap_v2(&p0, &p3); }
-    if(p0.y > p3.y){ swap_v2(&p0, &p3); }
-
-    if(p1.x < p0.x){ swap_v2(&p1, &p0); }
-    if(p1.x < p3.x){ swap_v2(&p1, &p3); }
-    if(p1.y > p2.y){ swap_v2(&p1, &p2); }
-    if(p1.y > p3.y){ swap_v2(&p1, &p3); }
-
-    if(p2.x < p0.x){ swap_v2(&p2, &p0); }
-    if(p2.x < p3.x){ swap_v2(&p2, &p3); }
-    if(p2.y < p0.y){ swap_v2(&p2, &p0); }
-    if(p2.y < p1.y){ swap_v2(&p2, &p1); }
+static f32
+orient_v2(v2 a, v2 b, v2 c){
+    f32 result = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    return(result);
+}
 
-    if(p3.x > p1.x){ swap_v2(&p3, &p1); }
-    if(p3.x > p2.x){ swap_v2(&p3, &p2); }
-    if(p3.y < p0.y){ swap_v2(&p3, &p0); }
-    if(p3.y < p1.y){ swap_v2(&p3, &p1); }
+// NOTE: points can come in any order. Pick the diagonal from p0 that has the other two points
+// on opposite sides, then the quad is the two triangles on either side of it.
+static void
+draw_quad(RenderBuffer *render_buffer, RectS32 clip, v2 p0, v2 p1, v2 p2, v2 p3, RGBA color, bool fill){
+    v2 diagonal = p2;
+    v2 a = p1;
+    v2 b = p3;
+    if(orient_v2(p0, p2, p1) * orient_v2(p0, p2, p3) >= 0){
+        if(orient_v2(p0, p3, p1) * orient_v2(p0, p3, p2) < 0){
+            diagonal = p3;
+            a = p1;
+            b = p2;
+        }
+        else{
+            diagonal = p1;
+            a = p2;
+            b = p3;
+        }
+    }
 
-    draw_triangle(render_buffer, p0, p1, p2, color, fill);
-    draw_triangle(render_buffer, p0, p2, p3, color, fill);
+    if(fill){
+        fill_triangle(render_buffer, clip, p0, a, diagonal, color);
+        fill_triangle(render_buffer, clip, p0, diagonal, b, color);
+    }
+    else{
+        draw_segment(render_buffer, clip, p0, a, color);
+        draw_segment(render_buffer, clip, a, diagonal, color);
+        draw_segment(render_buffer, clip, diagonal, b, color);
+        draw_segment(render_buffer, clip, b, p0, color);
+    }
 }
 
 static void
-draw_polygon(RenderBuffer *render_buffer, v2 *points, u32 count, RGBA color){
+draw_polygon(RenderBuffer *render_buffer, RectS32 clip, v2 *points, u32 count, RGBA color){
     v2 first = *points++;
     v2 prev = first;
     for(u32 i=1; i<count; ++i){
-        draw_segment(render_buffer, prev, *points, color);
+        draw_segment(render_buffer, clip, prev, *points, color);
         prev = *points++;
     }
-    draw_segment(render_buffer, first, prev, color);
+    draw_segment(render_buffer, clip, first, prev, color);
+}
+
+// NOTE: pixels on row with center offset dy from the ellipse center whose centers fall inside, as [x0, x1)
+static bool
+ellipse_row_span(f32 center_x, v2 rad, f32 dy, s32 *x0, s32 *x1){
+    if(rad.x <= 0 || rad.y <= 0 || abs_f32(dy) >= rad.y){
+        return(false);
+    }
+
+    f32 t = dy / rad.y;
+    f32 half_width = rad.x * sqrt_f32(1.0f - t * t);
+    *x0 = (s32)ceil_f32(center_x - half_width - 0.5f);
+    *x1 = -(s32)ceil_f32(-(center_x + half_width - 0.5f)) + 1;
+    return(*x0 < *x1);
+}
+
+// NOTE: signed distance in pixels from p (relative to center) to the ellipse edge, negative inside.
+// Uses the first order (f - 1) / |grad f| approximation, which is exact for circles near the edge.
+static f32
+ellipse_edge_distance(v2 p, v2 rad){
+    if(rad.x <= 0 || rad.y <= 0){
+        return(1000.0f);
+    }
+
+    f32 ix = p.x / (rad.x * rad.x);
+    f32 iy = p.y / (rad.y * rad.y);
+    f32 f = p.x * ix + p.y * iy;
+    f32 gradient = 2.0f * sqrt_f32(ix * ix + iy * iy);
+    if(gradient < 0.000001f){
+        return(f < 1.0f ? -1000.0f : 1000.0f);
+    }
+
+    f32 result = (f - 1.0f) / gradient;
+    return(result);
 }
 
+// NOTE: fraction of a pixel covered by an edge at signed distance from its center
+static f32
+edge_coverage(f32 distance){
+    f32 result = 0.5f - distance;
+    if(result < 0) result = 0;
+    if(result > 1) result = 1;
+    return(result);
+}
+
+// NOTE: Every row is visited once and clipped before anything is written. Solid runs go through
+// fill_span. Outlines are one pixel thick, made by taking the (rad - 1) ellipse out of the full one.
+// With anti_aliased, pixels in the band around each edge get coverage from the distance to that
+// edge, and only the fully covered middle of the row is a solid span.
 static void
-draw_circle(RenderBuffer *render_buffer, f32 xm, f32 ym, f32 r, RGBA color, bool fill) {
-    f32 x = -r;
-    f32 y = 0;
-    f32 err = 2-2*r;
-    do {
-        draw_pixel(render_buffer, make_v2((xm - x), (ym + y)), color);
-        draw_pixel(render_buffer, make_v2((xm - y), (ym - x)), color);
-        draw_pixel(render_buffer, make_v2((xm + x), (ym - y)), color);
-        draw_pixel(render_buffer, make_v2((xm + y), (ym + x)), color);
-        r = err;
-        if (r <= y){
-            if(fill){
-                if(ym + y == ym - y){
-                    draw_segment(render_buffer, make_v2((xm - x - 1), (ym + y)), make_v2((xm + x), (ym + y)), color);
+draw_ellipse(RenderBuffer *render_buffer, RectS32 clip, v2 center, v2 rad, RGBA color, bool fill, bool anti_aliased){
+    u32 packed_color = rgba_to_u32(color);
+    u32 premultiplied_color = premultiply_u32(packed_color);
+    u32 color_a = packed_color >> 24;
+    if(color_a == 0 || rad.x <= 0 || rad.y <= 0){
+        return;
+    }
+
+    v2 inner_rad = {rad.x - 1.0f, rad.y - 1.0f};
+    f32 aa_pad = anti_aliased ? 0.5f : 0.0f;
+    v2 outer_rad = {rad.x + aa_pad, rad.y + aa_pad};
+    // NOTE: pixels inside solid_rad are fully covered by the ellipse, pixels inside hole_rad are fully
+    // covered by the hole of an outline.
+    v2 solid_rad = {rad.x - aa_pad, rad.y - aa_pad};
+    v2 hole_rad = {inner_rad.x - aa_pad, inner_rad.y - aa_pad};
+
+    s32 y_min = (s32)ceil_f32(center.y - outer_rad.y - 0.5f);
+    s32 y_max = -(s32)ceil_f32(-(center.y + outer_rad.y - 0.5f)) + 1;
+    if(y_min < clip.y0) y_min = clip.y0;
+    if(y_max > clip.y1) y_max = clip.y1;
+
+    for(s32 y=y_min; y < y_max; ++y){
+        f32 dy = ((f32)y + 0.5f) - center.y;
+        s32 outer_x0, outer_x1;
+        if(!ellipse_row_span(center.x, outer_rad, dy, &outer_x0, &outer_x1)){
+            continue;
+        }
+
+        // NOTE: [solid_x0, solid_x1) is drawn at full color, [hole_x0, hole_x1) is skipped
+        s32 solid_x0 = 0, solid_x1 = 0;
+        s32 hole_x0 = 0, hole_x1 = 0;
+        // NOTE: an anti aliased outline is all edge, nothing in it is guaranteed full coverage
+        bool has_solid = (fill || !anti_aliased) && ellipse_row_span(center.x, solid_rad, dy, &solid_x0, &solid_x1);
+        if(!has_solid){
+            solid_x0 = solid_x1 = outer_x0;
+        }
+        if(!fill){
+            if(!ellipse_row_span(center.x, hole_rad, dy, &hole_x0, &hole_x1)){
+                hole_x0 = hole_x1 = solid_x0;
+            }
+        }
+
+        u32* row = (u32*)((u8*)render_buffer->base + (y * render_buffer->stride));
+        s32 x0 = outer_x0 < clip.x0 ? clip.x0 : outer_x0;
+        s32 x1 = outer_x1 > clip.x1 ? clip.x1 : outer_x1;
+        s32 x = x0;
+        while(x < x1){
+            if(x >= hole_x0 && x < hole_x1){
+                x = hole_x1;
+                continue;
+            }
+
+            if(x >= solid_x0 && x < solid_x1){
+                s32 span_end = solid_x1 < x1 ? solid_x1 : x1;
+                if(hole_x0 > x && hole_x0 < span_end){
+                    span_end = hole_x0;
+                }
+                fill_span(row + x, span_end - x, packed_color);
+                x = span_end;
+                continue;
+            }
+
+            if(anti_aliased){
+                v2 p = {((f32)x + 0.5f) - center.x, dy};
+                f32 coverage = edge_coverage(ellipse_edge_distance(p, rad));
+                if(!fill){
+                    coverage -= edge_coverage(ellipse_edge_distance(p, inner_rad));
+                }
+                u32 coverage_255 = (u32)round_f32_s32(coverage * 255.0f);
+                if(coverage_255){
+                    blend_pixel(row + x, scale_premultiplied(premultiplied_color, coverage_255));
+                }
+            }
+            else{
+                // NOTE: outline pixels between the outer edge and the hole
+                if(color_a == 255){
+                    row[x] = packed_color;
                 }
                 else{
-                    draw_segment(render_buffer, make_v2((xm - x - 1), (ym + y)), make_v2((xm + x), (ym + y)), color);
-                    draw_segment(render_buffer, make_v2((xm - x - 1), (ym - y)), make_v2((xm + x), (ym - y)), color);
+                    blend_pixel(row + x, premultiplied_color);
                 }
             }
-            y++;
-            err += y * 2 + 1;
-        }
-        if (r > x || err > y){
-            x++;
-            err += x * 2 + 1;
+            ++x;
         }
-    } while (x < 0);
+    }
 }
 
 static void
-draw_commands(RenderBuffer *render_buffer, Arena *commands){
-    void* at = commands->base;
-    void* end = (u8*)commands->base + commands->used;
-    while(at != end){
-        CommandHeader* base_command = (CommandHeader*)at;
-
-        switch(base_command->type){
-            case RenderCommand_ClearColor:{
-                ClearColorCommand *command = (ClearColorCommand*)base_command;
-                clear_color(render_buffer, command->ch.color);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Pixel:{
-                PixelCommand *command = (PixelCommand*)base_command;
-                draw_pixel(render_buffer, make_v2(command->ch.rect.x0, command->ch.rect.y0), command->ch.color);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Segment:{
-                SegmentCommand *command = (SegmentCommand*)base_command;
-                draw_segment(render_buffer, command->p0, command->p1, command->ch.color);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Ray:{
-                RayCommand *command = (RayCommand*)base_command;
-                draw_ray(render_buffer, command->ch.rect, command->ch.direction, command->ch.color);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Line:{
-                LineCommand *command = (LineCommand*)base_command;
-                draw_line(render_buffer, command->ch.rect, command->ch.direction, command->ch.color);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Rect:{
-                RectCommand *command = (RectCommand*)base_command;
-                draw_rect(render_buffer, command->ch.rect, command->ch.color);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Basis:{
-                BasisCommand *command = (BasisCommand*)base_command;
+draw_command(RenderBuffer *render_buffer, RectS32 clip, CommandHeader *base_command){
+    switch(base_command->type){
+        case RenderCommand_ClearColor:{
+            ClearColorCommand *command = (ClearColorCommand*)base_command;
+            if(command->has_region){
+                clear_color_region(render_buffer, clip, command->region, command->color);
+            }
+            else{
+                clear_color(render_buffer, clip, command->color);
+            }
+        } break;
+        case RenderCommand_Pixel:{
+            PixelCommand *command = (PixelCommand*)base_command;
+            draw_pixel(render_buffer, clip, command->pos, u32_to_rgba_normal(command->color));
+        } break;
+        case RenderCommand_Segment:{
+            SegmentCommand *command = (SegmentCommand*)base_command;
+            draw_segment(render_buffer, clip, command->p0, command->p1, u32_to_rgba_normal(command->color));
+        } break;
+        case RenderCommand_Ray:{
+            RayCommand *command = (RayCommand*)base_command;
+            draw_ray(render_buffer, clip, command->pos, command->direction, u32_to_rgba_normal(command->color));
+        } break;
+        case RenderCommand_Line:{
+            LineCommand *command = (LineCommand*)base_command;
+            draw_line(render_buffer, clip, command->pos, command->direction, u32_to_rgba_normal(command->color));
+        } break;
+        case RenderCommand_Rect:{
+            RectCommand *command = (RectCommand*)base_command;
+            draw_rect(render_buffer, clip, command->rect, u32_to_rgba_normal(command->color));
+        } break;
+        case RenderCommand_Basis:{
+            BasisCommand *command = (BasisCommand*)base_command;
 #if 1
-                draw_bitmap_slow(render_buffer, command->ch.origin, command->ch.x_axis, command->ch.y_axis, &command->texture);
+            draw_bitmap_basis(render_buffer, clip, command->origin, command->x_axis, command->y_axis, &command->texture, command->trilinear);
 #else
-                RGBA color = {
-                    .r = 0.5f + 0.5f * sin_f32(angle*2.0f),
-                    .g = 0.5f + 0.5f * cos_f32(angle),
-                    .b = 0.5f + 0.5f * sin_f32(angle),
-                    //.a = 1.0f,
-                    .a = 0.5f + 0.5f * cos_f32(angle*2.0f),
-                };
-                draw_bitmap_slow(render_buffer, command->ch.origin, command->ch.x_axis, command->ch.y_axis, &command->texture, color);
+            RGBA color = {
+                .r = 0.5f + 0.5f * sin_f32(angle*2.0f),
+                .g = 0.5f + 0.5f * cos_f32(angle),
+                .b = 0.5f + 0.5f * sin_f32(angle),
+                //.a = 1.0f,
+                .a = 0.5f + 0.5f * cos_f32(angle*2.0f),
+            };
+            draw_bitmap_slow(render_buffer, clip, command->origin, command->x_axis, command->y_axis, &command->texture, command->trilinear, color);
 #endif
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Box:{
-                BoxCommand *command = (BoxCommand*)base_command;
-                draw_box(render_buffer, command->ch.rect, command->ch.color);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Quad:{
-                QuadCommand *command = (QuadCommand*)base_command;
-                draw_quad(render_buffer, command->p0, command->p1, command->p2, command->p3, command->ch.color, command->ch.fill);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Triangle:{
-                TriangleCommand *command = (TriangleCommand*)base_command;
-                draw_triangle(render_buffer, command->p0, command->p1, command->p2, base_command->color, base_command->fill);
-                at = (u8*)commands->base + command->ch.arena_used;
-            } break;
-            case RenderCommand_Circle:{
-                CircleCommand *command = (CircleCommand*)base_command;
-                draw_circle(render_buffer, command->ch.rect.x0, command->ch.rect.y0, command->ch.rad, command->ch.color, command->ch.fill);
-                at = (u8*)commands->base + command->ch.arena_used;
+        } break;
+        case RenderCommand_Box:{
+            BoxCommand *command = (BoxCommand*)base_command;
+            draw_box(render_buffer, clip, command->rect, u32_to_rgba_normal(command->color));
+        } break;
+        case RenderCommand_Quad:{
+            QuadCommand *command = (QuadCommand*)base_command;
+            draw_quad(render_buffer, clip, command->p0, command->p1, command->p2, command->p3, u32_to_rgba_normal(command->color), command->fill);
+        } break;
+        case RenderCommand_Triangle:{
+            TriangleCommand *command = (TriangleCommand*)base_command;
+            draw_triangle(render_buffer, clip, command->p0, command->p1, command->p2, u32_to_rgba_normal(command->color), command->fill);
+        } break;
+        case RenderCommand_Circle:{
+            CircleCommand *command = (CircleCommand*)base_command;
+            draw_ellipse(render_buffer, clip, command->center, command->rad, u32_to_rgba_normal(command->color), command->fill, command->anti_aliased);
+        } break;
+        case RenderCommand_Bitmap:{
+            BitmapCommand *command = (BitmapCommand*)base_command;
+            draw_bitmap(render_buffer, clip, command->pos, &command->texture);
+        } break;
+        case RenderCommand_Text:{
+            TextCommand *command = (TextCommand*)base_command;
+            draw_text(render_buffer, clip, command);
+        } break;
+        case RenderCommand_Layer:{
+        } break;
+    }
+}
+
+// --------------------------
+// tiled renderer
+// --------------------------
+
+// NOTE: Commands are binned into screen tiles by their bounding box, then every tile
+// is rasterized on the work queue with each draw_* clipped to the tile. Commands keep
+// their draw order (arena order, or sorted) inside a tile, so the output matches draw_commands().
+#define RENDER_TILE_WIDTH  64
+#define RENDER_TILE_HEIGHT 64
+
+// NOTE: Damage tracking. Every tile hashes the commands binned into it, and only tiles
+// whose hash changed since the last frame get rasterized (and presented by the platform).
+// Texel data isn't hashed, Bitmap::generation stands in for it (text hashes its font's atlas
+// generation), so anything that rewrites texels has to give the bitmap a new generation.
+// A dirty tile with no commands is cleared to black rather than left showing the old frame.
+#define RENDER_TILES_MAX 1024
+typedef struct TileDamage{
+    bool enabled;
+    bool valid; // NOTE: false until a full frame has been drawn, everything is dirty until then
+    s32 tile_count_x;
+    s32 tile_count_y;
+    u32 dirty_count;
+
+    u64 hashes[RENDER_TILES_MAX];
+    bool dirty[RENDER_TILES_MAX];
+} TileDamage;
+
+static void
+tile_damage_invalidate(TileDamage* damage){
+    damage->valid = false;
+}
+
+typedef struct RenderTile{
+    RenderBuffer* render_buffer;
+    RectS32 clip;
+
+    CommandHeader** commands;
+    u32 command_count;
+} RenderTile;
+
+static RectS32
+bounds_from_points(v2* points, u32 count, s32 padding){
+    v2 min = points[0];
+    v2 max = points[0];
+    for(u32 i=1; i < count; ++i){
+        v2 p = points[i];
+        if(p.x < min.x){ min.x = p.x; }
+        if(p.y < min.y){ min.y = p.y; }
+        if(p.x > max.x){ max.x = p.x; }
+        if(p.y > max.y){ max.y = p.y; }
+    }
+
+    RectS32 result = {
+        round_f32_s32(min.x) - padding,
+        round_f32_s32(min.y) - padding,
+        round_f32_s32(max.x) + padding + 1,
+        round_f32_s32(max.y) + padding + 1,
+    };
+    return(result);
+}
+
+// NOTE: conservative pixel bounds of everything a command can touch, not clipped.
+static RectS32
+command_bounds(RenderBuffer *render_buffer, CommandHeader *base_command){
+    RectS32 result = make_rect_s32(0, 0, render_buffer->width, render_buffer->height);
+
+    switch(base_command->type){
+        case RenderCommand_ClearColor:{
+            ClearColorCommand *command = (ClearColorCommand*)base_command;
+            if(command->has_region){
+                result = command->region;
+            }
+        } break;
+        case RenderCommand_Line:
+        case RenderCommand_Ray:{
+        } break;
+        case RenderCommand_Pixel:{
+            PixelCommand *command = (PixelCommand*)base_command;
+            v2 points[] = {command->pos};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Segment:{
+            SegmentCommand *command = (SegmentCommand*)base_command;
+            v2 points[] = {command->p0, command->p1};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Rect:{
+            RectCommand *command = (RectCommand*)base_command;
+            v2 points[] = {command->rect.min, command->rect.max};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Box:{
+            BoxCommand *command = (BoxCommand*)base_command;
+            v2 points[] = {command->rect.min, command->rect.max};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Basis:{
+            BasisCommand *command = (BasisCommand*)base_command;
+            v2 origin = command->origin;
+            v2 x_axis = command->x_axis;
+            v2 y_axis = command->y_axis;
+            v2 points[] = {origin, origin + x_axis, origin + y_axis, origin + x_axis + y_axis};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Quad:{
+            QuadCommand *command = (QuadCommand*)base_command;
+            v2 points[] = {command->p0, command->p1, command->p2, command->p3};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Triangle:{
+            TriangleCommand *command = (TriangleCommand*)base_command;
+            v2 points[] = {command->p0, command->p1, command->p2};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Circle:{
+            CircleCommand *command = (CircleCommand*)base_command;
+            v2 points[] = {command->center - command->rad, command->center + command->rad};
+            result = bounds_from_points(points, array_count(points), 2);
+        } break;
+        case RenderCommand_Bitmap:{
+            BitmapCommand *command = (BitmapCommand*)base_command;
+            v2 dim = {(f32)command->texture.width, (f32)command->texture.height};
+            v2 points[] = {command->pos, command->pos + dim};
+            result = bounds_from_points(points, array_count(points), 1);
+        } break;
+        case RenderCommand_Text:{
+            TextCommand *command = (TextCommand*)base_command;
+            result = command->bounds;
+        } break;
+        case RenderCommand_Layer:{
+            result = make_rect_s32(0, 0, 0, 0);
+        } break;
+    }
+    return(result);
+}
+
+// --------------------------
+// command sorting
+// --------------------------
+
+// NOTE: Optional sort pass. Commands are ordered by layer (push_layer()), and inside a layer
+// commands that use the same kernel and texture (see commands_batch()) are pulled together.
+// A command only ever moves back past commands its bounds don't overlap, so blending order
+// between anything that touches the same pixels is kept and the output matches the unsorted
+// draw. The look back is limited to COMMAND_SORT_WINDOW commands to keep this linear-ish.
+#define COMMAND_SORT_WINDOW 64
+
+typedef struct SortEntry{
+    CommandHeader* command;
+    s32 z;
+    RectS32 bounds;
+} SortEntry;
+
+// NOTE: stable LSD radix sort on z, a byte per pass. Flipping the sign bit makes the unsigned
+// byte order match signed order. Layers are small numbers so usually only the low byte differs,
+// passes where every entry has the same byte are skipped. Returns entries or the scratch copy,
+// whichever ends up holding the result.
+static SortEntry*
+sort_entries_by_z(Arena* arena, SortEntry* entries, u32 count){
+    SortEntry* other = push_array(arena, SortEntry, count);
+    for(u32 shift=0; shift < 32; shift += 8){
+        u32 offsets[256] = {0};
+        for(u32 i=0; i < count; ++i){
+            u32 key = ((u32)entries[i].z ^ 0x80000000) >> shift;
+            offsets[key & 0xFF]++;
+        }
+        if(count == 0 || offsets[(((u32)entries[0].z ^ 0x80000000) >> shift) & 0xFF] == count){
+            continue;
+        }
+
+        u32 total = 0;
+        for(u32 b=0; b < 256; ++b){
+            u32 bucket_count = offsets[b];
+            offsets[b] = total;
+            total += bucket_count;
+        }
+        for(u32 i=0; i < count; ++i){
+            u32 key = ((u32)entries[i].z ^ 0x80000000) >> shift;
+            other[offsets[key & 0xFF]++] = entries[i];
+        }
+
+        SortEntry* swap = entries;
+        entries = other;
+        other = swap;
+    }
+    return(entries);
+}
+
+// NOTE: true when b can be drawn in the same run as a
+static bool
+commands_batch(CommandHeader* a, CommandHeader* b){
+    if(a->type != b->type){
+        return(false);
+    }
+
+    bool result = true;
+    switch(a->type){
+        case RenderCommand_Basis:{
+            result = ((BasisCommand*)a)->texture.base == ((BasisCommand*)b)->texture.base;
+        } break;
+        case RenderCommand_Bitmap:{
+            result = ((BitmapCommand*)a)->texture.base == ((BitmapCommand*)b)->texture.base;
+        } break;
+        case RenderCommand_Text:{
+            result = ((TextCommand*)a)->font == ((TextCommand*)b)->font;
+        } break;
+    }
+    return(result);
+}
+
+// NOTE: the commands to draw, in arena order or sorted. Layer commands are dropped, they only
+// matter to the sort.
+static CommandHeader**
+command_list(Arena* arena, RenderBuffer *render_buffer, Arena *commands, bool sort, u32* count){
+    u32 command_count = 0;
+    for(u8* at = (u8*)commands->base; at != (u8*)commands->base + commands->used;){
+        CommandHeader* base_command = (CommandHeader*)at;
+        at += base_command->size;
+        if(base_command->type != RenderCommand_Layer){
+            command_count++;
+        }
+    }
+
+    CommandHeader** result = push_array(arena, CommandHeader*, command_count);
+    *count = command_count;
+    if(!sort){
+        u32 command_index = 0;
+        for(u8* at = (u8*)commands->base; at != (u8*)commands->base + commands->used;){
+            CommandHeader* base_command = (CommandHeader*)at;
+            at += base_command->size;
+            if(base_command->type != RenderCommand_Layer){
+                result[command_index++] = base_command;
+            }
+        }
+        return(result);
+    }
+
+    RectS32 screen = make_rect_s32(0, 0, render_buffer->width, render_buffer->height);
+    SortEntry* entries = push_array(arena, SortEntry, command_count);
+    u32 entry_count = 0;
+    s32 z = 0;
+    for(u8* at = (u8*)commands->base; at != (u8*)commands->base + commands->used;){
+        CommandHeader* base_command = (CommandHeader*)at;
+        at += base_command->size;
+        if(base_command->type == RenderCommand_Layer){
+            z = ((LayerCommand*)base_command)->z;
+            continue;
+        }
+
+        SortEntry entry = {base_command, z, rect_s32_intersection(command_bounds(render_buffer, base_command), screen)};
+        entries[entry_count++] = entry;
+    }
+    entries = sort_entries_by_z(arena, entries, entry_count);
+
+    // NOTE: batch inside each layer. Look back from the end of the output for a command this one
+    // batches with, stop at the first one it overlaps (it has to stay after that) or at another layer.
+    SortEntry* sorted = push_array(arena, SortEntry, command_count);
+    u32 sorted_count = 0;
+    for(u32 entry_index=0; entry_index < entry_count; ++entry_index){
+        SortEntry entry = entries[entry_index];
+        u32 insert_at = sorted_count;
+        u32 window = (sorted_count < COMMAND_SORT_WINDOW) ? sorted_count : COMMAND_SORT_WINDOW;
+        for(u32 back=1; back <= window; ++back){
+            SortEntry* other = sorted + sorted_count - back;
+            if(other->z != entry.z){
+                break;
+            }
+            if(commands_batch(other->command, entry.command)){
+                insert_at = sorted_count - back + 1;
+                break;
+            }
+            if(rect_s32_has_area(rect_s32_intersection(other->bounds, entry.bounds))){
+                break;
+            }
+        }
+
+        for(u32 i=sorted_count; i > insert_at; --i){
+            sorted[i] = sorted[i - 1];
+        }
+        sorted[insert_at] = entry;
+        sorted_count++;
+    }
+
+    for(u32 i=0; i < sorted_count; ++i){
+        result[i] = sorted[i].command;
+    }
+    return(result);
+}
+
+// NOTE: a run of basis draws sharing a texture, so they share the texels and the mip chain too. The
+// cpu path gets picked and every level's sampler set up once for the run, each quad then only picks
+// its lod and goes straight into the quad kernel.
+static void
+draw_basis_run(RenderBuffer *render_buffer, RectS32 clip, CommandHeader** commands, u32 count){
+    assert(cpu_features.detected);
+    Bitmap* texture = &((BasisCommand*)commands[0])->texture;
+    assert(texture->format == BitmapFormat_Linear16 || texture->format == BitmapFormat_Linear16Block);
+
+    if(cpu_features.avx2 || cpu_features.sse2){
+        TextureSamplers samplers;
+        init_texture_samplers(&samplers, texture);
+        if(cpu_features.avx2){
+            for(u32 i=0; i < count; ++i){
+                BasisCommand *command = (BasisCommand*)commands[i];
+                TextureLod lod = select_texture_lod(&command->texture, command->x_axis, command->y_axis, command->trilinear);
+                draw_basis_quad_8x(render_buffer, clip, command->origin, command->x_axis, command->y_axis, texture_samplers_lod(&samplers, lod));
+            }
+        }
+        else{
+            for(u32 i=0; i < count; ++i){
+                BasisCommand *command = (BasisCommand*)commands[i];
+                TextureLod lod = select_texture_lod(&command->texture, command->x_axis, command->y_axis, command->trilinear);
+                draw_basis_quad_4x(render_buffer, clip, command->origin, command->x_axis, command->y_axis, texture_samplers_lod(&samplers, lod));
+            }
+        }
+    }
+    else{
+        for(u32 i=0; i < count; ++i){
+            BasisCommand *command = (BasisCommand*)commands[i];
+            draw_bitmap_slow(render_buffer, clip, command->origin, command->x_axis, command->y_axis, &command->texture, command->trilinear);
+        }
+    }
+}
+
+// NOTE: splits a command list into runs that batch (commands_batch()). Basis runs go to the run
+// kernel draw_basis_run(), everything else goes through draw_command() one at a time.
+static void
+draw_command_list(RenderBuffer *render_buffer, RectS32 clip, CommandHeader** commands, u32 count){
+    u32 run_start = 0;
+    while(run_start < count){
+        u32 run_end = run_start + 1;
+        while(run_end < count && commands_batch(commands[run_start], commands[run_end])){
+            run_end++;
+        }
+
+        CommandHeader** run = commands + run_start;
+        u32 run_count = run_end - run_start;
+        switch(run[0]->type){
+            case RenderCommand_Basis:{
+                draw_basis_run(render_buffer, clip, run, run_count);
             } break;
-            case RenderCommand_Bitmap:{
-                BitmapCommand *command = (BitmapCommand*)base_command;
-                draw_bitmap(render_buffer, command->ch.rect.min, &command->texture);
-                at = (u8*)commands->base + command->ch.arena_used;
+            default:{
+                for(u32 i=0; i < run_count; ++i){
+                    draw_command(render_buffer, clip, run[i]);
+                }
             } break;
         }
+        run_start = run_end;
     }
 }
 
+static void
+draw_commands(RenderBuffer *render_buffer, Arena *commands, bool sort = false){
+    Arena* arena = render_buffer->arena;
+    arena_free(arena);
+    RectS32 clip = make_rect_s32(0, 0, render_buffer->width, render_buffer->height);
+    assert(cpu_features.detected);
+
+    u32 command_count = 0;
+    CommandHeader** command_order = command_list(arena, render_buffer, commands, sort, &command_count);
+    draw_command_list(render_buffer, clip, command_order, command_count);
+}
+
+static void
+render_tile_work(void* data){
+    RenderTile* tile = (RenderTile*)data;
+    draw_command_list(tile->render_buffer, tile->clip, tile->commands, tile->command_count);
+}
+
+static void
+draw_commands_tiled(RenderBuffer *render_buffer, Arena *commands, WorkQueue *queue, TileDamage *damage = 0, bool sort = false){
+    Arena* arena = render_buffer->arena;
+    arena_free(arena);
+    assert(cpu_features.detected);
+
+    s32 tile_count_x = (render_buffer->width  + RENDER_TILE_WIDTH  - 1) / RENDER_TILE_WIDTH;
+    s32 tile_count_y = (render_buffer->height + RENDER_TILE_HEIGHT - 1) / RENDER_TILE_HEIGHT;
+    s32 tile_count = tile_count_x * tile_count_y;
+    RectS32 screen = make_rect_s32(0, 0, render_buffer->width, render_buffer->height);
+
+    RenderTile* tiles = push_array(arena, RenderTile, (u32)tile_count);
+    for(s32 tile_y=0; tile_y < tile_count_y; ++tile_y){
+        for(s32 tile_x=0; tile_x < tile_count_x; ++tile_x){
+            RenderTile* tile = tiles + (tile_y * tile_count_x) + tile_x;
+            RectS32 clip = make_rect_s32(tile_x * RENDER_TILE_WIDTH,
+                                         tile_y * RENDER_TILE_HEIGHT,
+                                         (tile_x + 1) * RENDER_TILE_WIDTH,
+                                         (tile_y + 1) * RENDER_TILE_HEIGHT);
+            tile->render_buffer = render_buffer;
+            tile->clip = rect_s32_intersection(clip, screen);
+            tile->commands = 0;
+            tile->command_count = 0;
+        }
+    }
+
+    u32 command_count = 0;
+    CommandHeader** command_order = command_list(arena, render_buffer, commands, sort, &command_count);
+
+    // compute the tile range each command covers and count commands per tile
+    RectS32* tile_ranges = push_array(arena, RectS32, command_count);
+    for(u32 command_index=0; command_index < command_count; ++command_index){
+        CommandHeader* base_command = command_order[command_index];
+
+        RectS32 bounds = rect_s32_intersection(command_bounds(render_buffer, base_command), screen);
+        RectS32 range = {0, 0, 0, 0};
+        if(rect_s32_has_area(bounds)){
+            range.x0 = bounds.x0 / RENDER_TILE_WIDTH;
+            range.y0 = bounds.y0 / RENDER_TILE_HEIGHT;
+            range.x1 = ((bounds.x1 - 1) / RENDER_TILE_WIDTH) + 1;
+            range.y1 = ((bounds.y1 - 1) / RENDER_TILE_HEIGHT) + 1;
+        }
+        tile_ranges[command_index] = range;
+
+        for(s32 tile_y=range.y0; tile_y < range.y1; ++tile_y){
+            for(s32 tile_x=range.x0; tile_x < range.x1; ++tile_x){
+                tiles[(tile_y * tile_count_x) + tile_x].command_count++;
+            }
+        }
+    }
+
+    // allocate each tile's command list, then fill them in draw order
+    for(s32 i=0; i < tile_count; ++i){
+        RenderTile* tile = tiles + i;
+        tile->commands = push_array(arena, CommandHeader*, tile->command_count);
+        tile->command_count = 0;
+    }
+
+    for(u32 command_index=0; command_index < command_count; ++command_index){
+        CommandHeader* base_command = command_order[command_index];
+
+        RectS32 range = tile_ranges[command_index];
+        for(s32 tile_y=range.y0; tile_y < range.y1; ++tile_y){
+            for(s32 tile_x=range.x0; tile_x < range.x1; ++tile_x){
+                RenderTile* tile = tiles + (tile_y * tile_count_x) + tile_x;
+                tile->commands[tile->command_count++] = base_command;
+            }
+        }
+    }
+
+    // diff each tile against last frame
+    bool track_damage = damage && damage->enabled;
+    if(track_damage){
+        assert(tile_count <= RENDER_TILES_MAX);
+        if(damage->tile_count_x != tile_count_x || damage->tile_count_y != tile_count_y){
+            damage->tile_count_x = tile_count_x;
+            damage->tile_count_y = tile_count_y;
+            damage->valid = false;
+        }
+
+        damage->dirty_count = 0;
+        for(s32 i=0; i < tile_count; ++i){
+            RenderTile* tile = tiles + i;
+            u64 hash = HASH_SEED;
+            for(u32 command_i=0; command_i < tile->command_count; ++command_i){
+                CommandHeader* base_command = tile->commands[command_i];
+                hash = hash_bytes(hash, base_command, base_command->size);
+                if(base_command->type == RenderCommand_Text){
+                    TextCommand* command = (TextCommand*)base_command;
+                    hash = hash_bytes(hash, &command->font->atlas.generation, sizeof(command->font->atlas.generation));
+                }
+            }
+
+            bool dirty = !damage->valid || (hash != damage->hashes[i]);
+            damage->hashes[i] = hash;
+            damage->dirty[i] = dirty;
+            if(dirty){
+                damage->dirty_count++;
+            }
+        }
+        damage->valid = true;
+    }
+
+    // NOTE: when every tile gets redrawn (damage off, first frame, a repaint) and the list starts
+    // with a full screen clear, that clear is done once here over the whole buffer instead of a
+    // 16KB piece per tile. That's big enough for clear_color() to use streaming stores. It covers
+    // every tile, so it's first in every tile's list and the tiles just start after it.
+    bool cleared = false;
+    bool all_dirty = !track_damage || damage->dirty_count == (u32)tile_count;
+    if(all_dirty && command_count && command_order[0]->type == RenderCommand_ClearColor){
+        ClearColorCommand* clear = (ClearColorCommand*)command_order[0];
+        if(!clear->has_region){
+            clear_color(render_buffer, screen, clear->color);
+            for(s32 i=0; i < tile_count; ++i){
+                assert(tiles[i].command_count && tiles[i].commands[0] == command_order[0]);
+                tiles[i].commands++;
+                tiles[i].command_count--;
+            }
+            cleared = true;
+        }
+    }
+
+    // rasterize
+    for(s32 i=0; i < tile_count; ++i){
+        RenderTile* tile = tiles + i;
+        if(track_damage && !damage->dirty[i]){
+            continue;
+        }
+        if(tile->command_count){
+            work_queue_add_entry(queue, render_tile_work, tile);
+        }
+        else if(track_damage && !cleared){
+            clear_color(render_buffer, tile->clip, 0);
+        }
+    }
+    work_queue_complete_all(queue);
+}
 
 
 
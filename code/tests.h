@@ -0,0 +1,266 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+// NOTE: Checks that are too slow or too exhaustive to run in the game, run by `roids_headless test`.
+// A failing check prints where it was and counts, so one run reports everything that's broken
+// and the exit code says whether anything did.
+
+global u32 test_check_count;
+global u32 test_failure_count;
+
+#define test_check(expr) test_check_((expr), #expr, __FILE__, __LINE__)
+
+static void
+test_check_(bool ok, const char* expr, const char* file, s32 line){
+    test_check_count++;
+    if(!ok){
+        // NOTE: exhaustive tests can fail thousands of times in a row, the first few are enough
+        if(test_failure_count < 32){
+            printf("%s:%d: check failed: %s\n", file, line, expr);
+        }
+        test_failure_count++;
+    }
+}
+
+// --------------------------
+// renderer
+// --------------------------
+
+TARGET_AVX2 static void
+test_blend_8x(u32* dest, u32* src, u32* expected){
+    u32 result[8];
+    _mm256_storeu_si256((__m256i*)result, blend_8x(_mm256_loadu_si256((__m256i*)dest), _mm256_loadu_si256((__m256i*)src)));
+    for(u32 lane=0; lane < 8; ++lane){
+        test_check(result[lane] == expected[lane]);
+    }
+}
+
+// NOTE: the integer blend against the float blend it replaces (within 1 per channel), and the
+// SIMD blends against blend_pixel (exact)
+static void
+test_blend_precision(void){
+    for(u32 x=0; x < 256; ++x){
+        for(u32 y=0; y < 256; ++y){
+            test_check(mul_div_255(x, y) == (u32)round_f32_s32((f32)(x * y) / 255.0f));
+        }
+    }
+
+    for(u32 a=0; a < 256; ++a){
+        for(u32 c=0; c < 256; c += 5){
+            for(u32 d=0; d < 256; d += 5){
+                f32 expected = ((f32)c * (f32)a + (f32)d * (f32)(255 - a)) / 255.0f;
+                u32 premultiplied = premultiply_u32((a << 24) | c);
+                u32 pixel = d;
+                blend_pixel(&pixel, premultiplied);
+                f32 error = abs_f32((f32)(pixel & 0xFF) - expected);
+                test_check(error <= 1.0f);
+            }
+        }
+    }
+
+    u32 seed = 0x12345678;
+    for(u32 i=0; i < 256; ++i){
+        u32 dest[8];
+        u32 src[8];
+        for(u32 lane=0; lane < 8; ++lane){
+            seed = seed * 1664525 + 1013904223;
+            dest[lane] = seed;
+            seed = seed * 1664525 + 1013904223;
+            src[lane] = premultiply_u32(seed);
+        }
+
+        u32 expected[8];
+        for(u32 lane=0; lane < 8; ++lane){
+            expected[lane] = dest[lane];
+            blend_pixel(expected + lane, src[lane]);
+        }
+
+        u32 premultiplied[4];
+        _mm_storeu_si128((__m128i*)premultiplied, premultiply_4x(_mm_loadu_si128((__m128i*)dest)));
+        for(u32 lane=0; lane < 4; ++lane){
+            test_check(premultiplied[lane] == premultiply_u32(dest[lane]));
+        }
+
+        u32 result[8];
+        _mm_storeu_si128((__m128i*)result, blend_4x(_mm_loadu_si128((__m128i*)dest), _mm_loadu_si128((__m128i*)src)));
+        _mm_storeu_si128((__m128i*)(result + 4), blend_4x(_mm_loadu_si128((__m128i*)(dest + 4)), _mm_loadu_si128((__m128i*)(src + 4))));
+        for(u32 lane=0; lane < 8; ++lane){
+            test_check(result[lane] == expected[lane]);
+        }
+
+        if(cpu_features.avx2){
+            test_blend_8x(dest, src, expected);
+        }
+    }
+}
+
+// NOTE: interleaved and negative layers have to come out ordered by z, and in push order inside a layer
+static void
+test_sort_entries_by_z(Arena* arena){
+    u32 count = 4096;
+    SortEntry* entries = push_array(arena, SortEntry, count);
+    u32 seed = 0x9E3779B9;
+    for(u32 i=0; i < count; ++i){
+        seed = seed * 1664525 + 1013904223;
+        entries[i].command = (CommandHeader*)(u64)(i + 1);
+        entries[i].z = (s32)(seed >> 20) - 2048;
+        if(i % 7 == 0){
+            entries[i].z *= 100000;
+        }
+    }
+
+    SortEntry* sorted = sort_entries_by_z(arena, entries, count);
+    for(u32 i=1; i < count; ++i){
+        test_check(sorted[i - 1].z <= sorted[i].z);
+        if(sorted[i - 1].z == sorted[i].z){
+            test_check((u64)sorted[i - 1].command < (u64)sorted[i].command);
+        }
+    }
+
+    // NOTE: one layer, every pass gets skipped
+    for(u32 i=0; i < count; ++i){
+        entries[i].z = -3;
+    }
+    sorted = sort_entries_by_z(arena, entries, count);
+    test_check(sorted == entries);
+}
+
+// --------------------------
+// collision
+// --------------------------
+
+// NOTE: rects are min/max, edges are exclusive for all three
+static void
+test_rect(void){
+    Rect a = make_rect(10, 10, 50, 50);
+    test_check(rect_collides_rect(a, make_rect(40, 40, 100, 100)));
+    test_check(rect_collides_rect(make_rect(40, 40, 100, 100), a));
+    test_check(rect_collides_rect(a, make_rect(20, 20, 30, 30)));
+    test_check(!rect_collides_rect(a, make_rect(50, 10, 90, 50)));
+    test_check(!rect_collides_rect(a, make_rect(10, 50, 50, 90)));
+    // NOTE: overlaps if x1/y1 were read as width/height
+    test_check(!rect_collides_rect(make_rect(100, 100, 120, 120), make_rect(10, 10, 95, 95)));
+
+    test_check(rect_collides_point(a, make_v2(30, 30)));
+    test_check(!rect_collides_point(a, make_v2(10, 30)));
+    test_check(!rect_collides_point(a, make_v2(30, 50)));
+    test_check(!rect_collides_point(a, make_v2(55, 30)));
+    test_check(!rect_collides_point(make_rect(100, 100, 120, 120), make_v2(110, 90)));
+
+    test_check(rect_contains_rect(a, make_rect(20, 20, 30, 30)));
+    test_check(rect_contains_rect(make_rect(100, 100, 200, 200), make_rect(150, 150, 180, 180)));
+    test_check(!rect_contains_rect(a, a));
+    test_check(!rect_contains_rect(a, make_rect(20, 20, 60, 30)));
+    test_check(!rect_contains_rect(make_rect(20, 20, 30, 30), a));
+}
+
+static bool
+test_bodies_overlap(f32* x, f32* y, Collider* colliders, u32 a, u32 b){
+    f32 dx = x[b] - x[a];
+    f32 dy = y[b] - y[a];
+    f32 radii = colliders[a].radius + colliders[b].radius;
+    bool result = colliders[a].layer && colliders[b].layer &&
+                  colliders_interact(colliders[a], colliders[b]) && (dx*dx + dy*dy) < radii*radii;
+    return(result);
+}
+
+// NOTE: the grid has to report exactly the pairs a brute force sweep finds, once each. Bodies are
+// a mix of game layers, layer 0 with a full mask (never collides), a few big ones that force
+// bigger cells and some out of bounds.
+static void
+test_spatial_grid(Arena* arena){
+    u32 count = 3000;
+    Rect bounds = make_rect(0, 0, 1280, 720);
+    f32* x = push_array(arena, f32, count);
+    f32* y = push_array(arena, f32, count);
+    Collider* colliders = push_array(arena, Collider, count);
+
+    u32 seed = 0x2545F491;
+    for(u32 i=0; i < count; ++i){
+        seed = seed * 1664525 + 1013904223;
+        x[i] = (f32)(seed >> 8) / (f32)(1 << 24) * 1480.0f - 100.0f;
+        seed = seed * 1664525 + 1013904223;
+        y[i] = (f32)(seed >> 8) / (f32)(1 << 24) * 920.0f - 100.0f;
+        seed = seed * 1664525 + 1013904223;
+        colliders[i].radius = 2.0f + (f32)(seed >> 27);
+        if(i % 500 == 0){
+            colliders[i].radius = 150.0f;
+        }
+        switch((seed >> 8) % 4){
+            case 0:{
+                colliders[i].layer = CollisionLayer_Ship;
+                colliders[i].mask = CollisionLayer_Asteroid;
+            } break;
+            case 1:{
+                colliders[i].layer = CollisionLayer_Asteroid;
+                colliders[i].mask = CollisionLayer_Ship|CollisionLayer_Bullet;
+            } break;
+            case 2:{
+                colliders[i].layer = CollisionLayer_Bullet;
+                colliders[i].mask = CollisionLayer_Asteroid;
+            } break;
+            default:{
+                colliders[i].layer = 0;
+                colliders[i].mask = 0xFFFF;
+            } break;
+        }
+    }
+
+    u32 expected_count = 0;
+    for(u32 a=0; a < count; ++a){
+        for(u32 b=a + 1; b < count; ++b){
+            expected_count += (u32)test_bodies_overlap(x, y, colliders, a, b);
+        }
+    }
+    test_check(expected_count > 0);
+
+    SpatialGrid grid = spatial_grid_build(arena, x, y, colliders, count, bounds, 64.0f);
+    test_check(grid.cell_size >= 300.0f);
+    u32 capacity = expected_count;
+    CollisionPair* pairs = push_array(arena, CollisionPair, capacity + 1);
+    u32 pair_count = spatial_grid_overlaps(&grid, pairs, capacity);
+    test_check(pair_count == expected_count);
+
+    // NOTE: one bit per ordered pair, catches pairs reported twice
+    u32 seen_words = (count * count + 31) / 32;
+    u32* seen = push_array(arena, u32, seen_words);
+    for(u32 i=0; i < seen_words; ++i){
+        seen[i] = 0;
+    }
+    u32 checked = pair_count < capacity ? pair_count : capacity;
+    for(u32 i=0; i < checked; ++i){
+        u32 a = pairs[i].a < pairs[i].b ? pairs[i].a : pairs[i].b;
+        u32 b = pairs[i].a < pairs[i].b ? pairs[i].b : pairs[i].a;
+        test_check(a != b && b < count);
+        test_check(test_bodies_overlap(x, y, colliders, a, b));
+        u32 bit = a * count + b;
+        test_check((seen[bit / 32] & (1u << (bit % 32))) == 0);
+        seen[bit / 32] |= 1u << (bit % 32);
+    }
+
+    // NOTE: short on room, still counts everything and fills what fits in the same order
+    u32 small_capacity = expected_count / 2;
+    CollisionPair* small_pairs = push_array(arena, CollisionPair, small_capacity + 1);
+    test_check(spatial_grid_overlaps(&grid, small_pairs, small_capacity) == expected_count);
+    for(u32 i=0; i < small_capacity; ++i){
+        test_check(small_pairs[i].a == pairs[i].a && small_pairs[i].b == pairs[i].b);
+    }
+}
+
+// NOTE: returns how many checks failed
+static u32
+run_tests(void){
+    test_check_count = 0;
+    test_failure_count = 0;
+
+    Arena* arena = make_arena(MB(64));
+    test_blend_precision();
+    test_sort_entries_by_z(arena);
+    test_rect();
+    test_spatial_grid(arena);
+
+    printf("tests: %u checks - %u failed\n", test_check_count, test_failure_count);
+    return(test_failure_count);
+}
+
+#endif